@@ -0,0 +1,343 @@
+//
+//  DeJitter.c
+//  AlephOne
+//
+/**
+    The send clock is a second order delay locked loop over packet arrivals (the same filter
+    that audio drivers use to smooth their interrupt times).  While a gesture is streaming,
+    packets come at a roughly constant rate, so the loop settles on that period and each packet
+    gets a filtered time that ignores how late the transport happened to deliver it.  A gap
+    in the stream much longer than the period resets the loop to the next arrival.
+
+    The queue is single producer (put) and single consumer (release).
+ */
+
+#include "DeJitter.h"
+#include "DeMIDI.h"
+#include <math.h>
+#include "FretlessCommon.h"
+
+#define DEJITTER_QUEUEMAX 1024
+#define DEJITTER_TWOPI 6.283185307179586
+#define DEJITTER_DEFAULT_PERIOD 0.005
+#define DEJITTER_DEFAULT_BANDWIDTH 2.0
+//Gaps longer than this many periods are a new gesture rather than a late packet
+#define DEJITTER_RESET_PERIODS 8
+#define DEJITTER_MIN_PERIOD 0.0005
+#define DEJITTER_MAX_PERIOD 0.1
+
+struct DeJitter_message
+{
+    double sendTime;
+    int length;
+    unsigned char bytes[3];
+};
+
+/**
+ Running sums for the RMS of the change in interval between consecutive messages
+ */
+struct DeJitter_stat
+{
+    double lastTime;
+    double lastInterval;
+    int primed;
+    double sumSquares;
+    long count;
+};
+
+struct DeJitter_context
+{
+    double sampleRate;
+    double delay;
+    double bandwidth;
+    //Loop state: t0 is the filtered time of the last packet, t1 the prediction for the next
+    int locked;
+    double t0;
+    double t1;
+    double period;
+    double lastArrival;
+    double lastSendTime;
+    int runningStatus;
+    //Ring of messages.  head is only written by put, tail only by release.
+    struct DeJitter_message queue[DEJITTER_QUEUEMAX];
+    unsigned int head;
+    unsigned int tail;
+    struct DeJitter_stat in;
+    struct DeJitter_stat out;
+    long late;
+    long dropped;
+    void (*dejitterFree)(void*);
+};
+
+static void DeJitter_resetStat(struct DeJitter_stat* s)
+{
+    s->primed = 0;
+    s->sumSquares = 0;
+    s->count = 0;
+}
+
+static void DeJitter_addStat(struct DeJitter_stat* s,double t)
+{
+    double interval = t - s->lastTime;
+    if(s->primed > 1)
+    {
+        double d = interval - s->lastInterval;
+        s->sumSquares += d*d;
+        s->count++;
+    }
+    if(s->primed > 0)
+    {
+        s->lastInterval = interval;
+    }
+    if(s->primed < 2)
+    {
+        s->primed++;
+    }
+    s->lastTime = t;
+}
+
+static double DeJitter_rms(struct DeJitter_stat* s)
+{
+    return (s->count > 0) ? 1000 * sqrt(s->sumSquares / s->count) : 0;
+}
+
+struct DeJitter_context* DeJitter_init(double sampleRate, double delaySeconds,
+                                       void* (*dejitterAlloc)(unsigned long),
+                                       void (*dejitterFree)(void*))
+{
+    struct DeJitter_context* ctxp = dejitterAlloc(sizeof(struct DeJitter_context));
+    ctxp->sampleRate = sampleRate;
+    ctxp->delay = delaySeconds;
+    ctxp->bandwidth = DEJITTER_DEFAULT_BANDWIDTH;
+    ctxp->locked = FALSE;
+    ctxp->period = DEJITTER_DEFAULT_PERIOD;
+    ctxp->lastArrival = 0;
+    ctxp->lastSendTime = 0;
+    ctxp->runningStatus = 0;
+    ctxp->head = 0;
+    ctxp->tail = 0;
+    ctxp->late = 0;
+    ctxp->dropped = 0;
+    DeJitter_resetStat(&ctxp->in);
+    DeJitter_resetStat(&ctxp->out);
+    ctxp->dejitterFree = dejitterFree;
+    return ctxp;
+}
+
+void DeJitter_free(struct DeJitter_context* ctxp)
+{
+    ctxp->dejitterFree(ctxp);
+}
+
+void DeJitter_setDelay(struct DeJitter_context* ctxp, double delaySeconds)
+{
+    ctxp->delay = delaySeconds;
+}
+
+void DeJitter_setBandwidth(struct DeJitter_context* ctxp, double hz)
+{
+    ctxp->bandwidth = hz;
+}
+
+/**
+ Run the loop for a packet arriving at t, and return its filtered send time
+ */
+static double DeJitter_track(struct DeJitter_context* ctxp,double t)
+{
+    double e = t - ctxp->t1;
+    if(!ctxp->locked || e > DEJITTER_RESET_PERIODS*ctxp->period || e < -ctxp->period)
+    {
+        //Start over from this packet, guessing the period from the gap if it is plausible
+        double gap = t - ctxp->lastArrival;
+        if(ctxp->locked && DEJITTER_MIN_PERIOD < gap && gap < DEJITTER_MAX_PERIOD)
+        {
+            ctxp->period = gap;
+        }
+        ctxp->locked = TRUE;
+        ctxp->t0 = t;
+        ctxp->t1 = t + ctxp->period;
+        return t;
+    }
+    double w = DEJITTER_TWOPI * ctxp->bandwidth * ctxp->period;
+    double b = sqrt(2) * w;
+    double c = w * w;
+    ctxp->t0 = ctxp->t1;
+    ctxp->t1 += b*e + ctxp->period;
+    ctxp->period += c*e;
+    if(ctxp->period < DEJITTER_MIN_PERIOD)ctxp->period = DEJITTER_MIN_PERIOD;
+    if(ctxp->period > DEJITTER_MAX_PERIOD)ctxp->period = DEJITTER_MAX_PERIOD;
+    //Never let the filtered time fall behind what the buffer can absorb
+    if(t - ctxp->t0 > ctxp->delay)
+    {
+        ctxp->t0 = t - ctxp->delay;
+    }
+    return ctxp->t0;
+}
+
+static void DeJitter_enqueue(struct DeJitter_context* ctxp,double sendTime,const unsigned char* bytes,int length)
+{
+    unsigned int head = ctxp->head;
+    unsigned int tail = __atomic_load_n(&ctxp->tail,__ATOMIC_ACQUIRE);
+    if(head - tail >= DEJITTER_QUEUEMAX)
+    {
+        ctxp->dropped++;
+        return;
+    }
+    struct DeJitter_message* m = &ctxp->queue[head % DEJITTER_QUEUEMAX];
+    m->sendTime = sendTime;
+    m->length = length;
+    for(int i=0; i<length; i++)
+    {
+        m->bytes[i] = bytes[i];
+    }
+    __atomic_store_n(&ctxp->head,head+1,__ATOMIC_RELEASE);
+}
+
+//How many bytes a channel message takes, including status
+static int DeJitter_messageLength(int status)
+{
+    switch(status >> 4)
+    {
+        case 0x0C:
+        case 0x0D:
+            return 2;
+        default:
+            return 3;
+    }
+}
+
+/**
+ Find the next whole channel message at bytes[*i], restoring running status from *status, and
+ copy it to message.  Returns its length, or 0 at the end of the packet.
+ */
+static int DeJitter_next(const unsigned char* bytes, int length, int* i, int* status, unsigned char* message)
+{
+    while(*i < length)
+    {
+        int c = bytes[*i];
+        if(c >= 0xF8)
+        {
+            //Realtime bytes can appear anywhere and don't cancel running status
+            (*i)++;
+            continue;
+        }
+        if(c >= 0xF0)
+        {
+            //System common and sysex are not ours; skip to the next status byte
+            *status = 0;
+            for((*i)++; *i < length && bytes[*i] < 0x80; (*i)++);
+            continue;
+        }
+        if(c & 0x80)
+        {
+            *status = c;
+            (*i)++;
+        }
+        if(*status == 0)
+        {
+            (*i)++;
+            continue;
+        }
+        int n = DeJitter_messageLength(*status);
+        if(*i + n - 1 > length)
+        {
+            return 0;
+        }
+        message[0] = *status;
+        for(int d=1; d<n; d++)
+        {
+            message[d] = bytes[(*i)++];
+        }
+        //Poly aftertouch and program change are skipped; DeMIDI would misread their data
+        if(DeMIDI_parses(*status))
+        {
+            return n;
+        }
+    }
+    return 0;
+}
+
+void DeJitter_put(struct DeJitter_context* ctxp, double arrivalTime, const unsigned char* bytes, int length)
+{
+    //Count the whole channel messages first, so that however many the packet holds they can
+    //all be spread over its period, then queue them from a second pass
+    unsigned char message[3];
+    int status = ctxp->runningStatus;
+    int i = 0;
+    int count = 0;
+    while(DeJitter_next(bytes,length,&i,&status,message) > 0)
+    {
+        count++;
+    }
+    if(count == 0)
+    {
+        ctxp->runningStatus = status;
+        return;
+    }
+
+    double t0 = DeJitter_track(ctxp,arrivalTime);
+    ctxp->lastArrival = arrivalTime;
+    //A burst was produced over the packet period that led up to it, so spread it back out
+    i = 0;
+    int n;
+    for(int m=0; (n = DeJitter_next(bytes,length,&i,&ctxp->runningStatus,message)) > 0; m++)
+    {
+        double sendTime = t0 - ctxp->period * (count-1-m) / count;
+        if(sendTime < ctxp->lastSendTime)
+        {
+            sendTime = ctxp->lastSendTime;
+        }
+        ctxp->lastSendTime = sendTime;
+        DeJitter_addStat(&ctxp->in,arrivalTime);
+        DeJitter_enqueue(ctxp,sendTime,message,n);
+    }
+}
+
+void DeJitter_release(struct DeJitter_context* ctxp, double blockTime, double blockSample, int blockLength)
+{
+    unsigned int tail = ctxp->tail;
+    unsigned int head = __atomic_load_n(&ctxp->head,__ATOMIC_ACQUIRE);
+    double blockEnd = blockSample + blockLength;
+    while(tail != head)
+    {
+        struct DeJitter_message* m = &ctxp->queue[tail % DEJITTER_QUEUEMAX];
+        double sample = blockSample + (m->sendTime + ctxp->delay - blockTime) * ctxp->sampleRate;
+        if(sample >= blockEnd)
+        {
+            break;
+        }
+        if(sample < blockSample)
+        {
+            ctxp->late++;
+            sample = blockSample;
+        }
+        DeJitter_addStat(&ctxp->out,sample / ctxp->sampleRate);
+        DeMIDI_setTime(sample);
+        for(int i=0; i<m->length; i++)
+        {
+            DeMIDI_putch((char)m->bytes[i]);
+        }
+        tail++;
+    }
+    __atomic_store_n(&ctxp->tail,tail,__ATOMIC_RELEASE);
+}
+
+double DeJitter_getInputJitter(struct DeJitter_context* ctxp)
+{
+    return DeJitter_rms(&ctxp->in);
+}
+
+double DeJitter_getOutputJitter(struct DeJitter_context* ctxp)
+{
+    return DeJitter_rms(&ctxp->out);
+}
+
+long DeJitter_getLateCount(struct DeJitter_context* ctxp)
+{
+    return ctxp->late;
+}
+
+long DeJitter_getDroppedCount(struct DeJitter_context* ctxp)
+{
+    return ctxp->dropped;
+}
@@ -0,0 +1,63 @@
+//
+//  DeJitter.h
+//  AlephOne
+//
+
+/*
+ * An optional stage in front of DeMIDI for transports that deliver MIDI in bursts (USB, BLE).
+ *
+ * Packets are stamped with their arrival time on the transport's clock.  A delay locked loop
+ * turns those arrival times into a smoothed estimate of when the sender produced them, the
+ * messages of a burst are spread back out over the packet period, and everything is held in a
+ * small jitter buffer.  The audio thread then releases messages into DeMIDI with DeMIDI_setTime
+ * set to the sample they belong on, so a bend arrives as a smooth line instead of a staircase
+ * that steps at packet boundaries.
+ *
+ * put is called from the MIDI thread and release from the audio thread.  There are no locks
+ * and no allocation after init.
+ */
+struct DeJitter_context;
+
+/*
+ * delaySeconds is the depth of the jitter buffer; messages are released that long after the
+ * smoothed send time.  A few milliseconds covers USB; BLE connection intervals want more.
+ */
+struct DeJitter_context* DeJitter_init(double sampleRate, double delaySeconds,
+                                       void* (*dejitterAlloc)(unsigned long),
+                                       void (*dejitterFree)(void*));
+
+void DeJitter_free(struct DeJitter_context* ctxp);
+
+void DeJitter_setDelay(struct DeJitter_context* ctxp, double delaySeconds);
+
+/*
+ * How quickly the send clock follows changes in packet rate.  Lower is smoother.
+ */
+void DeJitter_setBandwidth(struct DeJitter_context* ctxp, double hz);
+
+/*
+ * One transport packet that arrived at arrivalTime (seconds).  It may hold several messages,
+ * with running status.
+ */
+void DeJitter_put(struct DeJitter_context* ctxp, double arrivalTime, const unsigned char* bytes, int length);
+
+/*
+ * Called at the start of each audio block.  blockTime is the transport clock time of the first
+ * sample of the block, and blockSample its sample number.  Every message due before the end of
+ * the block is put into DeMIDI, timestamped with the sample it should be applied on.
+ */
+void DeJitter_release(struct DeJitter_context* ctxp, double blockTime, double blockSample, int blockLength);
+
+/*
+ * RMS variation of the interval between consecutive messages, in milliseconds,
+ * as they arrived and as they were released.
+ */
+double DeJitter_getInputJitter(struct DeJitter_context* ctxp);
+double DeJitter_getOutputJitter(struct DeJitter_context* ctxp);
+
+/*
+ * Messages that were released after their reconstructed time because the buffer was too shallow,
+ * and messages dropped because the buffer was full.
+ */
+long DeJitter_getLateCount(struct DeJitter_context* ctxp);
+long DeJitter_getDroppedCount(struct DeJitter_context* ctxp);
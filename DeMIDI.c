@@ -12,6 +12,7 @@
 #include "DeMIDI.h"
 #include <stdio.h>
 #include "FretlessCommon.h"
+#include "EngineCommon.h"
 
 
 
@@ -29,6 +30,18 @@ void DeMIDI_stop()
     //Stop the sound engine
 }
 
+static double midiTime = 0;
+
+void DeMIDI_setTime(double sampleTime)
+{
+    midiTime = sampleTime;
+}
+
+double DeMIDI_getTime()
+{
+    return midiTime;
+}
+
 #define S_EXPECT_STATUS 0
 #define S_ON_BYTE_NOTE 1
 #define S_ON_BYTE_VOL 2
@@ -67,6 +80,30 @@ int expectNoteTie = 0;
 //Handle ambiguity if 6 and 38 in nrpn setting here.
 int isRegistered = 0;
 
+/**
+ The latest pitch and volume of every channel, kept side by side so that an engine can
+ convert all of them in one vector pass per block instead of one voice at a time.
+ */
+float DeMIDI_pitches[FINGERMAX] __attribute__((aligned(ENGINE_ALIGN)));
+float DeMIDI_volumes[FINGERMAX] __attribute__((aligned(ENGINE_ALIGN)));
+
+const float* DeMIDI_getPitches()
+{
+    return DeMIDI_pitches;
+}
+
+const float* DeMIDI_getVolumes()
+{
+    return DeMIDI_volumes;
+}
+
+static void DeMIDI_deliver(int channel,int attack,float pitch,float volVal,int exprParm,int expr)
+{
+    DeMIDI_pitches[channel] = pitch;
+    DeMIDI_volumes[channel] = volVal;
+    rawEngine(channel,attack,pitch,volVal,exprParm,expr);
+}
+
 float computePitch(int channel)
 {
     return 1.0 * midiNote[channel] + (midiPitchBendSemis*(midiBend[channel] - 8192))/8192.0;    
@@ -77,6 +114,21 @@ float computeVol(int channel)
     return midiVol[channel] / 127.0;                
 }
 
+int DeMIDI_parses(int status)
+{
+    switch(status >> 4)
+    {
+        case 0x08:
+        case 0x09:
+        case 0x0B:
+        case 0x0D:
+        case 0x0E:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
 /**
  Just do the decode as an FSM
  The nrpn/rpn stuff is just nuts...
@@ -129,17 +181,17 @@ void DeMIDI_putch(char c)
             case S_ON_BYTE_VOL:
                 midiVol[midiChannel] = (int)(c & 0x7F);
                 expectState = S_ON_BYTE_NOTE;
-                rawEngine(midiChannel,doNoteAttack,computePitch(midiChannel),computeVol(midiChannel),midiExprParm,midiExpr);
+                DeMIDI_deliver(midiChannel,doNoteAttack,computePitch(midiChannel),computeVol(midiChannel),midiExprParm,midiExpr);
                 return;
                 
             case S_OFF_BYTE_NOTE:
                 midiNote[midiChannel] = (int)(c & 0x7F);
-                expectState = S_OFF_BYTE_NOTE;
+                expectState = S_OFF_BYTE_VOL;
                 return;
             case S_OFF_BYTE_VOL:
                 midiVol[midiChannel] = 0;
                 expectState = S_OFF_BYTE_NOTE;
-                rawEngine(midiChannel,doNoteAttack,computePitch(midiChannel),0,midiExprParm,midiExpr);
+                DeMIDI_deliver(midiChannel,doNoteAttack,computePitch(midiChannel),0,midiExprParm,midiExpr);
                 return;
                 
             case S_BEND_LO:
@@ -149,7 +201,7 @@ void DeMIDI_putch(char c)
             case S_BEND_HI:
                 midiBend[midiChannel] = (((int)(c & 0x7F))<<7) + midiBend[midiChannel];
                 expectState = S_BEND_LO;
-                rawEngine(midiChannel,doNoteAttack,computePitch(midiChannel),computeVol(midiChannel),midiExprParm,midiExpr);
+                DeMIDI_deliver(midiChannel,doNoteAttack,computePitch(midiChannel),computeVol(midiChannel),midiExprParm,midiExpr);
                 return;
             
             case S_RPN_LO:
@@ -203,7 +255,7 @@ void DeMIDI_putch(char c)
                 if(midiVol[midiChannel])
                 {
                     midiVol[midiChannel] = (int)(c & 0x7F);
-                    rawEngine(midiChannel,0,computePitch(midiChannel),computeVol(midiChannel),midiExprParm,midiExpr);                    
+                    DeMIDI_deliver(midiChannel,0,computePitch(midiChannel),computeVol(midiChannel),midiExprParm,midiExpr);                    
                 }
                 return;
                 
@@ -239,3 +291,218 @@ void DeMIDI_flush()
     //We don't do anything with data boundaries right now
 }
 
+
+/**
+ Universal MIDI Packet decoding.
+ 
+ Words are gathered into whole packets based on the message type in the top nibble
+ of the first word.  MIDI 2.0 channel voice packets are decoded straight into pitch and
+ volume, so nothing gets rounded down to 7 or 14 bits on the way in.  Groups are folded
+ onto the same 16 channels, since we only have one note per channel anyway.
+ 
+ Per-note messages only apply when they name the note currently on the channel.
+ */
+#define UMP_WORDSMAX 4
+#define UMP_MT_MIDI1 0x2
+#define UMP_MT_MIDI2 0x4
+#define UMP_BENDCENTER 2147483648.0
+#define UMP_PERNOTE_PITCH 3
+#define UMP_ATTR_PITCH 3
+
+static const int umpPacketWords[16] = {1,1,1,2,2,4,1,1,2,2,2,3,3,4,4,4};
+static unsigned int umpWords[UMP_WORDSMAX];
+static int umpWordCount = 0;
+
+//Full resolution state for the MIDI 2.0 path
+float umpNotePitch[FINGERMAX];
+float umpBend[FINGERMAX];
+float umpNoteBend[FINGERMAX];
+float umpVol[FINGERMAX];
+int umpNoteBendSemis = 48;
+
+float computeUMPPitch(int channel)
+{
+    return umpNotePitch[channel] + midiPitchBendSemis*umpBend[channel] + umpNoteBendSemis*umpNoteBend[channel];
+}
+
+static float umpBendToFloat(unsigned int v)
+{
+    return (float)((v - UMP_BENDCENTER) / UMP_BENDCENTER);
+}
+
+static float umpUnitToFloat(unsigned int v)
+{
+    return (float)(v / 4294967295.0);
+}
+
+static void umpResetNote(int channel,int note)
+{
+    midiNote[channel] = note;
+    umpNotePitch[channel] = note;
+    umpNoteBend[channel] = 0;
+}
+
+static void umpDeliver(int channel)
+{
+    DeMIDI_deliver(channel,doNoteAttack,computeUMPPitch(channel),umpVol[channel],midiExprParm,midiExpr);
+}
+
+//A MIDI 1.0 channel voice message wrapped in a single word goes through the byte parser
+static void DeMIDI_putUMP_MIDI1(unsigned int w)
+{
+    int status = (w >> 16) & 0xFF;
+    DeMIDI_putch((char)status);
+    DeMIDI_putch((char)((w >> 8) & 0x7F));
+    if((status & 0xE0) != 0xC0)
+    {
+        DeMIDI_putch((char)(w & 0x7F));
+    }
+}
+
+static void DeMIDI_putUMP_MIDI2(unsigned int w0,unsigned int w1)
+{
+    int status  = (w0 >> 20) & 0x0F;
+    int channel = (w0 >> 16) & 0x0F;
+    int index   = (w0 >>  8) & 0x7F;
+    int index2  =  w0        & 0xFF;
+    int isCurrentNote = (midiNote[channel] == index);
+    switch(status)
+    {
+        case 0x08:
+            //Note off
+            if(isCurrentNote)
+            {
+                umpVol[channel] = 0;
+                midiVol[channel] = 0;
+                umpDeliver(channel);
+            }
+            return;
+        case 0x09:
+            //Note on, optionally with an exact pitch attached
+            umpResetNote(channel,index);
+            if(index2 == UMP_ATTR_PITCH)
+            {
+                umpNotePitch[channel] = (w1 & 0xFFFF) / 512.0f;
+            }
+            umpVol[channel] = (w1 >> 16) / 65535.0f;
+            midiVol[channel] = (w1 >> 25);
+            umpDeliver(channel);
+            return;
+        case 0x0A:
+            //Poly pressure behaves like channel pressure on our one note
+            if(isCurrentNote && umpVol[channel] > 0)
+            {
+                umpVol[channel] = umpUnitToFloat(w1);
+                umpDeliver(channel);
+            }
+            return;
+        case 0x00:
+            //Registered per-note controller
+            if(isCurrentNote)
+            {
+                if(index2 == UMP_PERNOTE_PITCH)
+                {
+                    umpNotePitch[channel] = w1 / 33554432.0f;
+                }
+                else
+                {
+                    midiExprParm = index2;
+                    midiExpr = (w1 >> 25);
+                }
+                umpDeliver(channel);
+            }
+            return;
+        case 0x01:
+            //Assignable per-note controller
+            if(isCurrentNote)
+            {
+                midiExprParm = index2;
+                midiExpr = (w1 >> 25);
+                umpDeliver(channel);
+            }
+            return;
+        case 0x02:
+            //RPN: pitch bend sensitivity (whole semitones), and per-note bend sensitivity
+            if(index == 0 && index2 == 0)
+            {
+                midiPitchBendSemis = (w1 >> 25);
+            }
+            else
+            if(index == 0 && index2 == 7)
+            {
+                umpNoteBendSemis = (w1 >> 25);
+            }
+            return;
+        case 0x03:
+            //NRPN: the same note tie that Fretless sends
+            if(index == 9 && index2 == 71)
+            {
+                rawEngine(channel,1,0,0,0,0);
+            }
+            return;
+        case 0x06:
+            //Per-note pitch bend
+            if(isCurrentNote)
+            {
+                umpNoteBend[channel] = umpBendToFloat(w1);
+                umpDeliver(channel);
+            }
+            return;
+        case 0x0B:
+            if(index == 11)
+            {
+                midiExprParm = 11;
+                midiExpr = (w1 >> 25);
+                if(umpVol[channel] > 0)
+                {
+                    umpDeliver(channel);
+                }
+            }
+            return;
+        case 0x0D:
+            if(umpVol[channel] > 0)
+            {
+                umpVol[channel] = umpUnitToFloat(w1);
+                umpDeliver(channel);
+            }
+            return;
+        case 0x0E:
+            umpBend[channel] = umpBendToFloat(w1);
+            umpDeliver(channel);
+            return;
+        case 0x0F:
+            //Per-note management: a reset puts per-note controllers back to default
+            if(isCurrentNote && (index2 & 0x01))
+            {
+                umpResetNote(channel,index);
+                umpDeliver(channel);
+            }
+            return;
+        default:
+            //Program change and relative controllers don't affect pitch or volume
+            return;
+    }
+}
+
+void DeMIDI_putUMP(unsigned int word)
+{
+    umpWords[umpWordCount++] = word;
+    int mt = (umpWords[0] >> 28) & 0x0F;
+    if(umpWordCount < umpPacketWords[mt])
+    {
+        return;
+    }
+    umpWordCount = 0;
+    switch(mt)
+    {
+        case UMP_MT_MIDI1:
+            DeMIDI_putUMP_MIDI1(umpWords[0]);
+            return;
+        case UMP_MT_MIDI2:
+            DeMIDI_putUMP_MIDI2(umpWords[0],umpWords[1]);
+            return;
+        default:
+            //Utility, system, sysex and data packets are skipped whole
+            return;
+    }
+}
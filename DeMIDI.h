@@ -8,4 +8,33 @@ void DeMIDI_start(void (*rawEngine)(int midiChannel,int doNoteAttack,float pitch
 void DeMIDI_stop();
 
 void DeMIDI_putch(char c);
-void DeMIDI_flush();
\ No newline at end of file
+void DeMIDI_flush();
+
+/*
+   TRUE if putch parses channel messages with this status byte.  Anything else should be
+   dropped before it gets here, data bytes and all, or they will be taken for the last
+   status it did parse.
+ */
+int DeMIDI_parses(int status);
+
+/*
+   The current pitch (fractional MIDI note) and volume of every channel, FINGERMAX wide and
+   aligned for vector loads.  These are updated just before each rawEngine call.
+ */
+const float* DeMIDI_getPitches();
+const float* DeMIDI_getVolumes();
+
+/*
+   Timestamp, in samples, of the bytes about to be put.  An engine can read it back
+   from inside its rawEngine callback to place the event within its block.
+ */
+void DeMIDI_setTime(double sampleTime);
+double DeMIDI_getTime();
+
+/*
+   Universal MIDI Packets, one 32 bit word at a time as they come off the transport.
+   MIDI 2.0 channel voice messages are decoded directly at full resolution
+   (per-note pitch, per-note controllers, 16 bit velocity, 32 bit pressure and bend).
+   MIDI 1.0 channel voice packets are handed to putch.
+ */
+void DeMIDI_putUMP(unsigned int word);
\ No newline at end of file
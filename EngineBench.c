@@ -0,0 +1,574 @@
+//
+//  EngineBench.c
+//  AlephOne
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include "EngineBench.h"
+#include "RawEngine.h"
+#include "VoiceBank.h"
+#include "Wavetable.h"
+#include "RenderPool.h"
+#include "Governor.h"
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include "EngineCommon.h"
+
+//Long enough that clock resolution and warmup don't matter
+#define ENGINEBENCH_SAMPLES (1 << 24)
+//Spectrum length for aliasing measurements
+#define ENGINEBENCH_DFT 4096
+//Samples after a tier change in which EngineBench_tierSteps looks for a jump, and before the signal counts as steady
+#define ENGINEBENCH_SETTLE 256
+//How much larger than the steady signal's a step at a tier change may be
+#define ENGINEBENCH_JUMP 1.5
+
+static double EngineBench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+//Keep the optimizer from discarding what we render
+static volatile float EngineBench_sink;
+
+static double EngineBench_timeVoice(void (*render)(struct RawEngine_voice*,float*,int), float* out, int blockSize)
+{
+    struct RawEngine_voice v;
+    RawEngine_initVoice(&v);
+    RawEngine_setPitch(&v,60.5f,48000);
+    v.loD = 0.3f;
+    v.loE = 0.7f;
+    int blocks = ENGINEBENCH_SAMPLES / blockSize;
+    double started = EngineBench_now();
+    for(int b=0; b<blocks; b++)
+    {
+        render(&v,out,blockSize);
+        EngineBench_sink = out[blockSize-1];
+    }
+    double elapsed = EngineBench_now() - started;
+    return elapsed * 1e9 / ((double)blocks * blockSize);
+}
+
+double EngineBench_rawEngine(int blockSize, int (*logger)(const char*,...))
+{
+    float* out;
+    if(posix_memalign((void**)&out,ENGINE_ALIGN,blockSize*sizeof(float)) != 0)
+    {
+        return 0;
+    }
+    double block = EngineBench_timeVoice(RawEngine_render,out,blockSize);
+    double scalar = EngineBench_timeVoice(RawEngine_renderScalar,out,blockSize);
+    free(out);
+    logger("RawEngine, %d sample blocks: %f ns/sample block, %f ns/sample scalar reference\n",blockSize,block,scalar);
+    return block;
+}
+
+static void* EngineBench_alloc(unsigned long size)
+{
+    return malloc(size);
+}
+
+double EngineBench_voiceBank(int blockSize, float sampleRate, int (*logger)(const char*,...))
+{
+    struct VoiceBank_context* bank = VoiceBank_init(sampleRate,EngineBench_alloc,free);
+    for(int v=0; v<VOICEMAX; v++)
+    {
+        VoiceBank_update(bank,v,0,48 + v*1.5f,0.5f,11,v*8);
+        VoiceBank_setPan(bank,v,(v - VOICEMAX/2) / (float)VOICEMAX);
+    }
+    float* left = malloc(blockSize*sizeof(float));
+    float* right = malloc(blockSize*sizeof(float));
+    int blocks = ENGINEBENCH_SAMPLES / blockSize;
+    double started = EngineBench_now();
+    for(int b=0; b<blocks; b++)
+    {
+        VoiceBank_render(bank,left,right,blockSize);
+        EngineBench_sink = left[blockSize-1];
+    }
+    double perBlock = (EngineBench_now() - started) / blocks;
+    double deadline = blockSize / sampleRate;
+    double voicesPerCore = VOICEMAX * deadline / perBlock;
+    logger("VoiceBank, %d sample blocks at %.0f Hz: %f us per %d voice block (deadline %f us), %.0f voices per core\n",
+           blockSize,sampleRate,perBlock*1e6,VOICEMAX,deadline*1e6,voicesPerCore);
+    free(left);
+    free(right);
+    VoiceBank_free(bank);
+    return voicesPerCore;
+}
+
+static double EngineBench_timeBends(int blockSize, float sampleRate, int ramp)
+{
+    struct VoiceBank_context* bank = VoiceBank_init(sampleRate,EngineBench_alloc,free);
+    VoiceBank_setRamp(bank,ramp);
+    float* left = malloc(blockSize*sizeof(float));
+    float* right = malloc(blockSize*sizeof(float));
+    int blocks = ENGINEBENCH_SAMPLES / blockSize;
+    double started = EngineBench_now();
+    for(int b=0; b<blocks; b++)
+    {
+        //Every voice is in the middle of a bend
+        for(int v=0; v<VOICEMAX; v++)
+        {
+            VoiceBank_update(bank,v,0,48 + v + (b & 63)/64.0f,0.5f,0,0);
+        }
+        VoiceBank_render(bank,left,right,blockSize);
+        EngineBench_sink = left[blockSize-1];
+    }
+    double nsPerSample = (EngineBench_now() - started) * 1e9 / ((double)blocks * blockSize);
+    free(left);
+    free(right);
+    VoiceBank_free(bank);
+    return nsPerSample;
+}
+
+double EngineBench_ramps(int smallBlock, float sampleRate, int (*logger)(const char*,...))
+{
+    double stepped = EngineBench_timeBends(smallBlock,sampleRate,VOICEBANK_RAMP_STEP);
+    logger("VoiceBank bends, stepped, %d sample blocks: %f ns/sample\n",smallBlock,stepped);
+    double ramped = stepped;
+    for(int blockSize=smallBlock; blockSize<=16*smallBlock; blockSize*=4)
+    {
+        ramped = EngineBench_timeBends(blockSize,sampleRate,VOICEBANK_RAMP_EXPONENTIAL);
+        logger("VoiceBank bends, ramped, %d sample blocks: %f ns/sample\n",blockSize,ramped);
+    }
+    double saving = (stepped - ramped) / stepped;
+    logger("ramped %d sample blocks save %.1f%% over stepped %d sample blocks\n",16*smallBlock,saving*100,smallBlock);
+    return saving;
+}
+
+static double EngineBench_timeEvents(int blockSize, float sampleRate, int eventsPerBlock)
+{
+    struct VoiceBank_context* bank = VoiceBank_init(sampleRate,EngineBench_alloc,free);
+    for(int v=0; v<VOICEMAX; v++)
+    {
+        VoiceBank_update(bank,v,0,48 + v,0.5f,0,0);
+    }
+    float* left = malloc(blockSize*sizeof(float));
+    float* right = malloc(blockSize*sizeof(float));
+    int blocks = ENGINEBENCH_SAMPLES / blockSize;
+    double started = EngineBench_now();
+    for(int b=0; b<blocks; b++)
+    {
+        double blockStart = VoiceBank_getTime(bank);
+        for(int e=0; e<eventsPerBlock; e++)
+        {
+            int offset = 1 + e*(blockSize-1)/eventsPerBlock;
+            VoiceBank_schedule(bank,blockStart + offset,e % VOICEMAX,0,48 + e + (b & 7)/8.0f,0.5f,0,0);
+        }
+        VoiceBank_render(bank,left,right,blockSize);
+        EngineBench_sink = left[blockSize-1];
+    }
+    double perBlock = (EngineBench_now() - started) * 1e9 / blocks;
+    free(left);
+    free(right);
+    VoiceBank_free(bank);
+    return perBlock;
+}
+
+double EngineBench_events(int blockSize, float sampleRate, int (*logger)(const char*,...))
+{
+    double none = EngineBench_timeEvents(blockSize,sampleRate,0);
+    double one = EngineBench_timeEvents(blockSize,sampleRate,1);
+    double many = EngineBench_timeEvents(blockSize,sampleRate,16);
+    logger("VoiceBank, %d sample blocks: %.0f ns/block with no events, %.0f with 1 (+%.1f%%), %.0f with 16 (+%.1f%%)\n",
+           blockSize,none,one,(one-none)/none*100,many,(many-none)/none*100);
+    return (many - none) / none;
+}
+
+static double EngineBench_timeWavetable(struct Wavetable_bank* bank, float* out, int blockSize)
+{
+    struct Wavetable_voice v = {0, 0.0247f, 1, 0, 0.5f, 0, 60.5f, 0.3f, 0.7f, {1, 1, 1, 1}};
+    for(int s=0; s<blockSize; s++)
+    {
+        out[s] = 0;
+    }
+    int blocks = ENGINEBENCH_SAMPLES / blockSize;
+    double started = EngineBench_now();
+    for(int b=0; b<blocks; b++)
+    {
+        Wavetable_render(bank,&v,out,blockSize);
+        EngineBench_sink = out[blockSize-1];
+    }
+    double elapsed = EngineBench_now() - started;
+    return elapsed * 1e9 / ((double)blocks * blockSize);
+}
+
+/**
+ Power outside the harmonics of bin, relative to power on them, in dB.  A fundamental that is a
+ whole number of bins and an increment that is exact in binary make the signal periodic in the
+ window, so without aliasing everything lands on a harmonic bin; with bin prime, aliases don't.
+ */
+static double EngineBench_aliasing(const float* x, int bin)
+{
+    static double twiddle[ENGINEBENCH_DFT];
+    for(int i=0; i<ENGINEBENCH_DFT; i++)
+    {
+        twiddle[i] = cos(6.283185307179586 * i / ENGINEBENCH_DFT);
+    }
+    double harmonic = 0;
+    double aliased = 0;
+    for(int k=1; k<ENGINEBENCH_DFT/2; k++)
+    {
+        double re = 0;
+        double im = 0;
+        for(int i=0; i<ENGINEBENCH_DFT; i++)
+        {
+            int at = (k*i) % ENGINEBENCH_DFT;
+            re += x[i]*twiddle[at];
+            im += x[i]*twiddle[(at + 3*ENGINEBENCH_DFT/4) % ENGINEBENCH_DFT];
+        }
+        double power = re*re + im*im;
+        if(k % bin == 0)
+        {
+            harmonic += power;
+        }
+        else
+        {
+            aliased += power;
+        }
+    }
+    return 10*log10(aliased / harmonic);
+}
+
+double EngineBench_wavetable(int blockSize, float sampleRate, int (*logger)(const char*,...))
+{
+    struct Wavetable_bank* bank = Wavetable_init(sampleRate,EngineBench_alloc,free);
+    float* out;
+    if(posix_memalign((void**)&out,ENGINE_ALIGN,ENGINEBENCH_DFT*sizeof(float)) != 0)
+    {
+        Wavetable_free(bank);
+        return 0;
+    }
+    double raw = EngineBench_timeVoice(RawEngine_render,out,blockSize);
+    Wavetable_setInterpolation(bank,WAVETABLE_INTERPOLATE_NEAREST);
+    double nearest = EngineBench_timeWavetable(bank,out,blockSize);
+    Wavetable_setInterpolation(bank,WAVETABLE_INTERPOLATE_LINEAR);
+    double linear = EngineBench_timeWavetable(bank,out,blockSize);
+    logger("one voice, %d sample blocks: RawEngine %f ns/sample, wavetable %f nearest, %f linear\n",
+           blockSize,raw,nearest,linear);
+
+    //Saws, where aliasing is worst, from the middle of the keyboard to where RawEngine has faded to a sine
+    static const int bins[] = {37, 223, 1009};
+    double worst = -1000;
+    for(int b=0; b<3; b++)
+    {
+        float increment = (float)bins[b] / ENGINEBENCH_DFT;
+        float pitch = 69 + 12*log2f(increment*sampleRate/440);
+        struct RawEngine_voice r;
+        RawEngine_initVoice(&r);
+        RawEngine_setPitch(&r,pitch,sampleRate);
+        r.cyclesPerSample = increment;
+        r.loD = 1;
+        r.loE = 0;
+        RawEngine_render(&r,out,ENGINEBENCH_DFT);
+        double rawAliasing = EngineBench_aliasing(out,bins[b]);
+        struct Wavetable_voice w = {0, increment, 1, 0, 1, 0, pitch, 1, 0, {1, 1, 1, 1}};
+        for(int s=0; s<ENGINEBENCH_DFT; s++)
+        {
+            out[s] = 0;
+        }
+        Wavetable_render(bank,&w,out,ENGINEBENCH_DFT);
+        double tableAliasing = EngineBench_aliasing(out,bins[b]);
+        logger("saw at note %.1f (%.0f Hz): aliasing %.1f dB RawEngine, %.1f dB wavetable\n",
+               pitch,increment*sampleRate,rawAliasing,tableAliasing);
+        worst = (tableAliasing > worst) ? tableAliasing : worst;
+    }
+    free(out);
+    Wavetable_free(bank);
+    return worst;
+}
+
+static double EngineBench_timeSounding(int blockSize, float sampleRate, int sounding)
+{
+    struct VoiceBank_context* bank = VoiceBank_init(sampleRate,EngineBench_alloc,free);
+    //Spread over the channels, as Fretless allocates them
+    for(int n=0; n<sounding; n++)
+    {
+        VoiceBank_update(bank,(n*5) % VOICEMAX,0,48 + n,0.5f,0,0);
+    }
+    float* left = malloc(blockSize*sizeof(float));
+    float* right = malloc(blockSize*sizeof(float));
+    int blocks = ENGINEBENCH_SAMPLES / blockSize;
+    double started = EngineBench_now();
+    for(int b=0; b<blocks; b++)
+    {
+        VoiceBank_render(bank,left,right,blockSize);
+        EngineBench_sink = left[blockSize-1];
+    }
+    double perBlock = (EngineBench_now() - started) * 1e9 / blocks;
+    free(left);
+    free(right);
+    VoiceBank_free(bank);
+    return perBlock;
+}
+
+double EngineBench_activeVoices(int blockSize, float sampleRate, int (*logger)(const char*,...))
+{
+    double full = EngineBench_timeSounding(blockSize,sampleRate,VOICEMAX);
+    double one = full;
+    for(int sounding=0; sounding<=VOICEMAX; sounding = sounding ? sounding*2 : 1)
+    {
+        double perBlock = (sounding == VOICEMAX) ? full : EngineBench_timeSounding(blockSize,sampleRate,sounding);
+        if(sounding == 1)
+        {
+            one = perBlock;
+        }
+        logger("VoiceBank, %d sample blocks, %2d voices sounding: %.0f ns/block\n",blockSize,sounding,perBlock);
+    }
+    return one / full;
+}
+
+static double EngineBench_timePool(struct RenderPool* pool, int blockSize, float* left, float* right)
+{
+    int blocks = ENGINEBENCH_SAMPLES / blockSize / 8;
+    double started = EngineBench_now();
+    for(int b=0; b<blocks; b++)
+    {
+        RenderPool_render(pool,left,right,blockSize);
+        EngineBench_sink = left[blockSize-1];
+    }
+    return (EngineBench_now() - started) / blocks;
+}
+
+double EngineBench_renderPool(int threads, int banks, int blockSize, float sampleRate, int (*logger)(const char*,...))
+{
+    struct RenderPool* serial = RenderPool_init(1,blockSize,sampleRate,logger,EngineBench_alloc,free);
+    struct RenderPool* pool = RenderPool_init(threads,blockSize,sampleRate,logger,EngineBench_alloc,free);
+    struct VoiceBank_context* bank[RENDERPOOL_BANKMAX];
+    if(banks > RENDERPOOL_BANKMAX)banks = RENDERPOOL_BANKMAX;
+    for(int i=0; i<banks; i++)
+    {
+        bank[i] = VoiceBank_init(sampleRate,EngineBench_alloc,free);
+        for(int v=0; v<VOICEMAX; v++)
+        {
+            VoiceBank_update(bank[i],v,0,36 + v*2 + i*0.1f,0.5f,11,v*8);
+        }
+        RenderPool_addBank(serial,bank[i]);
+        RenderPool_addBank(pool,bank[i]);
+    }
+    float* left = malloc(blockSize*sizeof(float));
+    float* right = malloc(blockSize*sizeof(float));
+    double one = EngineBench_timePool(serial,blockSize,left,right);
+    double many = EngineBench_timePool(pool,blockSize,left,right);
+    double deadline = blockSize / sampleRate;
+    logger("RenderPool, %d voices, %d sample blocks: %f us per block on 1 thread, %f us on %d (deadline %f us)\n",
+           banks*VOICEMAX,blockSize,one*1e6,many*1e6,threads,deadline*1e6);
+    for(int i=0; i<RenderPool_getThreadCount(pool); i++)
+    {
+        logger("  worker %d: load %.1f%%, %ld steals\n",i,RenderPool_getLoad(pool,i)*100,RenderPool_getSteals(pool,i));
+    }
+    RenderPool_free(serial);
+    RenderPool_free(pool);
+    for(int i=0; i<banks; i++)
+    {
+        VoiceBank_free(bank[i]);
+    }
+    free(left);
+    free(right);
+    return one / many;
+}
+
+/**
+ Like EngineBench_aliasing, for a fundamental that falls between bins.  A 4 term Blackman-Harris
+ window keeps leakage under -92dB, and its main lobe is 4 bins wide each side, so power within
+ that of a harmonic counts as harmonic.
+ */
+static double EngineBench_aliasingWindowed(const float* x, double bin)
+{
+    static float windowed[ENGINEBENCH_DFT];
+    for(int i=0; i<ENGINEBENCH_DFT; i++)
+    {
+        double t = 6.283185307179586 * i / ENGINEBENCH_DFT;
+        windowed[i] = x[i] * (0.35875 - 0.48829*cos(t) + 0.14128*cos(2*t) - 0.01168*cos(3*t));
+    }
+    double harmonic = 0;
+    double aliased = 0;
+    for(int k=1; k<ENGINEBENCH_DFT/2; k++)
+    {
+        double re = 0;
+        double im = 0;
+        for(int i=0; i<ENGINEBENCH_DFT; i++)
+        {
+            double t = 6.283185307179586 * (double)((long)k*i % ENGINEBENCH_DFT) / ENGINEBENCH_DFT;
+            re += windowed[i]*cos(t);
+            im += windowed[i]*sin(t);
+        }
+        double nearest = bin * floor(k/bin + 0.5);
+        if(fabs(k - nearest) <= 4)
+        {
+            harmonic += re*re + im*im;
+        }
+        else
+        {
+            aliased += re*re + im*im;
+        }
+    }
+    return 10*log10(aliased / harmonic);
+}
+
+double EngineBench_oversampling(int blockSize, float sampleRate, int (*logger)(const char*,...))
+{
+    float* out = malloc(ENGINEBENCH_DFT*sizeof(float));
+    double worst = 0;
+    for(int factor=1; factor<=4; factor*=2)
+    {
+        struct VoiceBank_context* bank = VoiceBank_init(sampleRate,EngineBench_alloc,free);
+        VoiceBank_setOversampling(bank,factor);
+        for(int v=0; v<VOICEMAX; v++)
+        {
+            VoiceBank_update(bank,v,0,48 + v*1.5f,0.5f,11,v*8);
+        }
+        float* left = malloc(blockSize*sizeof(float));
+        float* right = malloc(blockSize*sizeof(float));
+        int blocks = ENGINEBENCH_SAMPLES / blockSize / factor;
+        double started = EngineBench_now();
+        for(int b=0; b<blocks; b++)
+        {
+            VoiceBank_render(bank,left,right,blockSize);
+            EngineBench_sink = left[blockSize-1];
+        }
+        double perBlock = (EngineBench_now() - started) * 1e6 / blocks;
+        free(left);
+        free(right);
+        VoiceBank_free(bank);
+
+        //One saw, high enough to alias and low enough that the kernel hasn't faded it to a sine
+        double aliasing[2];
+        static const float notes[] = {88, 96};
+        for(int i=0; i<2; i++)
+        {
+            bank = VoiceBank_init(sampleRate,EngineBench_alloc,free);
+            VoiceBank_setOversampling(bank,factor);
+            VoiceBank_update(bank,0,0,notes[i],1,1,127);
+            VoiceBank_update(bank,0,0,notes[i],1,11,0);
+            VoiceBank_render(bank,out,NULL,ENGINEBENCH_DFT);
+            VoiceBank_render(bank,out,NULL,ENGINEBENCH_DFT);
+            double hz = 440 * pow(2,(notes[i] - 69)/12.0);
+            aliasing[i] = EngineBench_aliasingWindowed(out,hz / sampleRate * ENGINEBENCH_DFT);
+            VoiceBank_free(bank);
+        }
+        logger("VoiceBank %dx oversampled, %d sample blocks: %f us per %d voice block, aliasing %.1f dB at note %.0f, %.1f dB at note %.0f\n",
+               factor,blockSize,perBlock,VOICEMAX,aliasing[0],notes[0],aliasing[1],notes[1]);
+        worst = (factor == 4) ? aliasing[0] : worst;
+    }
+    free(out);
+    return worst;
+}
+
+/**
+ Half a second of two notes, then half a second of every finger down, over and over.
+ */
+static long EngineBench_governed(int blockSize, float sampleRate, float budget, int enabled, long* tierBlocks)
+{
+    struct VoiceBank_context* bank = VoiceBank_init(sampleRate,EngineBench_alloc,free);
+    struct Governor_context* governor = Governor_init(bank,sampleRate,EngineBench_alloc,free);
+    Governor_setBudget(governor,budget);
+    Governor_setEnabled(governor,enabled);
+    float* left = malloc(blockSize*sizeof(float));
+    float* right = malloc(blockSize*sizeof(float));
+    int phaseBlocks = (int)(sampleRate / 2 / blockSize);
+    for(int phase=0; phase<20; phase++)
+    {
+        int fingers = (phase & 1) ? VOICEMAX : 2;
+        for(int v=0; v<VOICEMAX; v++)
+        {
+            VoiceBank_update(bank,v,0,48 + v*1.5f,(v < fingers) ? 0.5f : 0,11,v*8);
+        }
+        for(int b=0; b<phaseBlocks; b++)
+        {
+            Governor_render(governor,left,right,blockSize);
+            EngineBench_sink = left[blockSize-1];
+            tierBlocks[Governor_getTier(governor)]++;
+        }
+    }
+    long misses = Governor_getDeadlineMisses(governor);
+    free(left);
+    free(right);
+    Governor_free(governor);
+    VoiceBank_free(bank);
+    return misses;
+}
+
+//Largest step between neighbouring samples in n samples, counting the one before them
+static double EngineBench_largestStep(float previous, float* samples, int n)
+{
+    double largest = 0;
+    for(int s=0; s<n; s++)
+    {
+        double step = fabs(samples[s] - previous);
+        largest = (step > largest) ? step : largest;
+        previous = samples[s];
+    }
+    return largest;
+}
+
+/**
+ Every finger down on a sine, whose own steps are small, while the tier walks from best to worst
+ and back, a quarter second each.  The
+ largest step just after each change, against the largest once settled at the tiers either side of
+ it; a tier change that clicks shows as a ratio well over 1.
+ */
+static double EngineBench_tierSteps(int blockSize, float sampleRate)
+{
+    struct VoiceBank_context* bank = VoiceBank_init(sampleRate,EngineBench_alloc,free);
+    struct Governor_context* governor = Governor_init(bank,sampleRate,EngineBench_alloc,free);
+    Governor_setEnabled(governor,FALSE);
+    int length = (int)(sampleRate / 4 / blockSize)*blockSize;
+    float* left = malloc(length*sizeof(float));
+    float* right = malloc(length*sizeof(float));
+    for(int v=0; v<VOICEMAX; v++)
+    {
+        VoiceBank_update(bank,v,0,48 + v*1.5f,0.5f,11,127);
+    }
+    float last = 0;
+    double steady = 0;
+    double worst = 0;
+    for(int i=0; i<2*GOVERNOR_TIERS-1; i++)
+    {
+        int tier = (i < GOVERNOR_TIERS) ? i : 2*(GOVERNOR_TIERS-1) - i;
+        Governor_setTierRange(governor,tier,tier);
+        for(int done=0; done<length; done+=blockSize)
+        {
+            Governor_render(governor,left+done,right+done,blockSize);
+        }
+        double change = EngineBench_largestStep(last,left,ENGINEBENCH_SETTLE);
+        double before = steady;
+        steady = EngineBench_largestStep(left[ENGINEBENCH_SETTLE-1],left+ENGINEBENCH_SETTLE,length-ENGINEBENCH_SETTLE);
+        if(i > 0)
+        {
+            double ratio = change / ((steady > before) ? steady : before);
+            worst = (ratio > worst) ? ratio : worst;
+        }
+        last = left[length-1];
+    }
+    free(left);
+    free(right);
+    Governor_free(governor);
+    VoiceBank_free(bank);
+    return worst;
+}
+
+double EngineBench_governor(int blockSize, float sampleRate, float budget, int (*logger)(const char*,...))
+{
+    long fixedTiers[GOVERNOR_TIERS] = {0};
+    long governedTiers[GOVERNOR_TIERS] = {0};
+    long fixed = EngineBench_governed(blockSize,sampleRate,budget,FALSE,fixedTiers);
+    long governed = EngineBench_governed(blockSize,sampleRate,budget,TRUE,governedTiers);
+    long blocks = 0;
+    for(int t=0; t<GOVERNOR_TIERS; t++)
+    {
+        blocks += governedTiers[t];
+    }
+    logger("Governor, %d sample blocks with %.1f%% of each block for the engine: %ld of %ld blocks missed at the best tier, %ld governed\n",
+           blockSize,budget*100,fixed,blocks,governed);
+    for(int t=0; t<GOVERNOR_TIERS; t++)
+    {
+        logger("  tier %d: %.1f%% of blocks\n",t,governedTiers[t]*100.0/blocks);
+    }
+    double jump = EngineBench_tierSteps(blockSize,sampleRate);
+    logger("  largest step at a tier change %.2f times the steady signal's: %s\n",jump,(jump > ENGINEBENCH_JUMP) ? "JUMPS" : "ok");
+    return (double)governed / (fixed ? fixed : 1);
+}
@@ -0,0 +1,68 @@
+//
+//  EngineBench.h
+//  AlephOne
+//
+// Timing of the engine's kernels on the machine we are running on.
+//
+// These use the OS clock, so they live apart from the kernels themselves.  Each one logs what it
+// measured and returns the headline number.
+
+/*
+ * ns per sample for one RawEngine voice rendered in blocks of blockSize,
+ * with the block renderer and with the scalar reference.  Returns the block renderer's figure.
+ */
+double EngineBench_rawEngine(int blockSize, int (*logger)(const char*,...));
+
+/*
+ * How many voices one core could keep up with in realtime, from timing a full VoiceBank
+ * (every voice sounding, stereo bus) at the given block size and sample rate.
+ */
+double EngineBench_voiceBank(int blockSize, float sampleRate, int (*logger)(const char*,...));
+
+/*
+ * ns per sample for a bank whose voices bend every block, rendered stepped in small blocks
+ * and ramped in each of the larger block sizes.  Returns the saving of the largest ramped
+ * block size over the small stepped one, as a fraction of the stepped cost.
+ */
+double EngineBench_ramps(int smallBlock, float sampleRate, int (*logger)(const char*,...));
+
+/*
+ * ns per block for a full bank with 0, 1 and 16 scheduled updates falling inside each block,
+ * which is the cost of splitting blocks for sample accurate events.  Returns the 16 event overhead
+ * as a fraction of the eventless block.
+ */
+double EngineBench_events(int blockSize, float sampleRate, int (*logger)(const char*,...));
+
+/*
+ * ns per sample for one voice from the RawEngine kernel and from a Wavetable bank (nearest and
+ * linear reads), then aliasing of each on saws at a few pitches.  Returns the wavetable's worst
+ * aliasing in dB relative to the harmonics.
+ */
+double EngineBench_wavetable(int blockSize, float sampleRate, int (*logger)(const char*,...));
+
+/*
+ * ns per block for a bank with 0, 1, 2, 4, 8 and all voices sounding, spread across the channels.
+ * Returns the one voice cost as a fraction of the full bank's.
+ */
+double EngineBench_activeVoices(int blockSize, float sampleRate, int (*logger)(const char*,...));
+
+/*
+ * us per block for banks full VoiceBanks (VOICEMAX voices each) rendered by a RenderPool of one
+ * thread and of threads threads, with each worker's load.  Returns the speedup.
+ */
+double EngineBench_renderPool(int threads, int banks, int blockSize, float sampleRate, int (*logger)(const char*,...));
+
+/*
+ * Quality against CPU for VoiceBank oversampling: us per full block and aliasing of a bright saw
+ * at 1x, 2x and 4x.  Returns the 4x aliasing at the lower note, in dB relative to the harmonics.
+ */
+double EngineBench_oversampling(int blockSize, float sampleRate, int (*logger)(const char*,...));
+
+/*
+ * Deadline misses for a bank alternating between two notes and every finger down, when the engine
+ * may use budget of each block's period, at a fixed best tier and under the Governor, with how long
+ * the Governor spent at each tier.  Also walks a held chord through every tier and back, and logs
+ * the largest step at a change against the steady signal's, marking JUMPS over 1.5.  Returns
+ * governed misses as a fraction of fixed ones.
+ */
+double EngineBench_governor(int blockSize, float sampleRate, float budget, int (*logger)(const char*,...));
@@ -0,0 +1,54 @@
+//
+//  EngineCommon.h
+//  AlephOne
+//
+// Shared by the internal sound engine that sits behind DeMIDI.
+//
+// The engine works on all voices at once.  A voice is a MIDI channel (DeMIDI only handles one
+// note per channel), so per-voice state is kept as arrays of VOICEMAX floats, and those arrays are
+// walked ENGINE_LANES at a time.  These are GCC/Clang vector extensions, which lower to NEON on
+// iOS and SSE on x86 without separate code paths.
+
+#ifndef ENGINECOMMON_H
+#define ENGINECOMMON_H
+
+#include "FretlessCommon.h"
+
+#ifndef VOICEMAX
+#define VOICEMAX FINGERMAX
+#endif
+
+#define ENGINE_LANES 4
+#define ENGINE_ALIGN 64
+
+typedef float Engine_vf __attribute__((vector_size(ENGINE_LANES*sizeof(float))));
+typedef int   Engine_vi __attribute__((vector_size(ENGINE_LANES*sizeof(int))));
+
+//Every lane set to c
+#define Engine_splat(c) ((Engine_vf){0,0,0,0} + (float)(c))
+
+//Per lane mask ? a : b, where mask lanes are all ones or all zeros (as comparisons give)
+static inline Engine_vf Engine_select(Engine_vi mask,Engine_vf a,Engine_vf b)
+{
+    return (Engine_vf)(((Engine_vi)a & mask) | ((Engine_vi)b & ~mask));
+}
+
+static inline Engine_vf Engine_min(Engine_vf a,Engine_vf b)
+{
+    return Engine_select(a < b,a,b);
+}
+
+static inline Engine_vf Engine_max(Engine_vf a,Engine_vf b)
+{
+    return Engine_select(a > b,a,b);
+}
+
+//Round toward negative infinity, as integers
+static inline Engine_vi Engine_floori(Engine_vf x)
+{
+    Engine_vi xi = __builtin_convertvector(x,Engine_vi);
+    //Truncation rounded negative values up; comparisons are -1 where true
+    return xi + (__builtin_convertvector(xi,Engine_vf) > x);
+}
+
+#endif
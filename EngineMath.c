@@ -0,0 +1,26 @@
+//
+//  EngineMath.c
+//  AlephOne
+//
+
+#include "EngineMath.h"
+#include <math.h>
+
+#define ENGINEMATH_A4_NOTE 69
+#define ENGINEMATH_A4_HZ 440
+
+void EngineMath_pitchToIncrement(const float* pitch, float* increment, float sampleRate)
+{
+    //increment = 440/sampleRate * 2^((pitch-69)/12), with everything but pitch folded into one offset
+    float offset = log2f(ENGINEMATH_A4_HZ / sampleRate) - ENGINEMATH_A4_NOTE / 12.0f;
+    for(int v=0; v<VOICEMAX; v+=ENGINE_LANES)
+    {
+        Engine_vf p = *(const Engine_vf*)&pitch[v];
+        *(Engine_vf*)&increment[v] = EngineMath_exp2(p * (1.0f/12) + offset);
+    }
+}
+
+float EngineMath_pitchToIncrementScalar(float pitch, float sampleRate)
+{
+    return ENGINEMATH_A4_HZ * powf(2, (pitch - ENGINEMATH_A4_NOTE) / 12.0f) / sampleRate;
+}
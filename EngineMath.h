@@ -0,0 +1,66 @@
+//
+//  EngineMath.h
+//  AlephOne
+//
+// Vector math for the engine.
+
+#ifndef ENGINEMATH_H
+#define ENGINEMATH_H
+
+#include "EngineCommon.h"
+
+/*
+ * 2^x on every lane, without calling into libm.
+ *
+ * The integer part goes straight into the float exponent, and the fractional part uses a
+ * 4th order polynomial fit for relative error over [0,1).  The polynomial's worst case relative
+ * error is 2.6e-6, or 0.0045 cents when x is a pitch in octaves.  With float rounding of the
+ * input included, EngineMath_pitchToIncrement stays within 0.006 cents of the powf reference
+ * over MIDI notes -20 to 150.  x is clamped to the normal float range.
+ */
+static inline Engine_vf EngineMath_exp2(Engine_vf x)
+{
+    x = Engine_max(x,Engine_splat(-126));
+    x = Engine_min(x,Engine_splat(127));
+    Engine_vi xi = Engine_floori(x);
+    Engine_vf f = x - __builtin_convertvector(xi,Engine_vf);
+    Engine_vf p = Engine_splat(0.0135340576f);
+    p = p*f + 0.0520116726f;
+    p = p*f + 0.241442632f;
+    p = p*f + 0.693003857f;
+    p = p*f + 1.00000259f;
+    Engine_vi scale = (xi + 127) << 23;
+    return p * (Engine_vf)scale;
+}
+
+/*
+ * 2^x for a per sample ratio that will be raised to the length of a block.  EngineMath_exp2 is
+ * 2.6e-6 out even at x = 0, which compounds to 2 cents of drift over 500 samples, so small x
+ * (under 1/8, any glide longer than 8 samples per octave) use a Taylor series that is exact at 0
+ * and within 4e-8 relative over that range.
+ */
+static inline Engine_vf EngineMath_exp2Ratio(Engine_vf x)
+{
+    Engine_vf t = x * 0.693147181f;
+    Engine_vf p = Engine_splat(1.0f/24);
+    p = p*t + 1.0f/6;
+    p = p*t + 0.5f;
+    p = p*t + 1;
+    p = p*t + 1;
+    Engine_vf ax = Engine_max(x,-x);
+    return Engine_select(ax < 0.125f,p,EngineMath_exp2(x));
+}
+
+/*
+ * Fractional MIDI note numbers for every voice, as DeMIDI_getPitches gives them,
+ * to oscillator phase increments in cycles per sample.  One vectorized pass over all VOICEMAX
+ * voices, once per block.  Both arrays must be aligned for Engine_vf.
+ */
+void EngineMath_pitchToIncrement(const float* pitch, float* increment, float sampleRate);
+
+/*
+ * The same conversion with powf, one voice at a time.  This is the reference for the error bound.
+ */
+float EngineMath_pitchToIncrementScalar(float pitch, float sampleRate);
+
+#endif
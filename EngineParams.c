@@ -0,0 +1,167 @@
+//
+//  EngineParams.c
+//  AlephOne
+//
+// This should remain a *pure* C library with no references to external libraries
+
+#include "EngineParams.h"
+#include "EngineMath.h"
+#include "FretlessCommon.h"
+
+//Set in the middle slot's index when the UI has put a set there that the audio thread hasn't taken
+#define ENGINEPARAMS_FRESH 4
+//Keeps what each thread writes off the other's cache lines
+#define ENGINEPARAMS_LINE 64
+//Close enough to the target to stop gliding, so the values don't creep through denormals
+#define ENGINEPARAMS_SETTLED 1e-6f
+
+static const float EngineParams_defaultSmoothing[ENGINEPARAMS_COUNT] =
+{
+    0.02f, 0.02f, 0.02f, 0.02f,
+    0.01f,
+    0.05f
+};
+
+struct EngineParams_context
+{
+    struct EngineParams_set slot[3];
+    char padSlots[ENGINEPARAMS_LINE];
+    //UI thread only
+    int back;
+    char padBack[ENGINEPARAMS_LINE];
+    //Exchanged by both
+    int middle;
+    char padMiddle[ENGINEPARAMS_LINE];
+    //Audio thread only
+    int front;
+    float target[ENGINEPARAMS_COUNT];
+    float current[ENGINEPARAMS_COUNT];
+    //Each parameter's smoothing as the reciprocal of its time constant in samples, 0 to jump
+    float perSample[ENGINEPARAMS_COUNT];
+    float sampleRate;
+    void (*engineParamsFree)(void*);
+};
+
+static float EngineParams_perSample(float sampleRate, float seconds)
+{
+    return (seconds > 0) ? 1 / (seconds * sampleRate) : 0;
+}
+
+/**
+ 1 - e^-t, how far a one pole gets toward its target in t time constants.  Small t, which long
+ smoothing in short blocks gives, would lose most of its bits to cancellation against 1, so it
+ uses the series directly.
+ */
+static float EngineParams_approach(float t)
+{
+    if(t < 0.125f)
+    {
+        return t * (1 - t * (0.5f - t * (1.0f/6 - t * (1.0f/24))));
+    }
+    return 1 - EngineMath_exp2(Engine_splat(t * -1.44269504f))[0];
+}
+
+void EngineParams_defaults(struct EngineParams_set* set)
+{
+    set->value[ENGINEPARAMS_W00] = 1;
+    set->value[ENGINEPARAMS_W01] = 1;
+    set->value[ENGINEPARAMS_W10] = 1;
+    set->value[ENGINEPARAMS_W11] = 1;
+    set->value[ENGINEPARAMS_GAIN] = 1;
+    set->value[ENGINEPARAMS_TUNE] = 0;
+}
+
+struct EngineParams_context* EngineParams_init(float sampleRate, const struct EngineParams_set* initial,
+                                               void* (*engineParamsAlloc)(unsigned long),
+                                               void (*engineParamsFree)(void*))
+{
+    struct EngineParams_context* ctxp = engineParamsAlloc(sizeof(struct EngineParams_context));
+    struct EngineParams_set defaults;
+    EngineParams_defaults(&defaults);
+    if(!initial)
+    {
+        initial = &defaults;
+    }
+    for(int i=0; i<3; i++)
+    {
+        ctxp->slot[i] = *initial;
+    }
+    ctxp->back = 0;
+    ctxp->middle = 1;
+    ctxp->front = 2;
+    for(int p=0; p<ENGINEPARAMS_COUNT; p++)
+    {
+        ctxp->target[p] = initial->value[p];
+        ctxp->current[p] = initial->value[p];
+        ctxp->perSample[p] = EngineParams_perSample(sampleRate,EngineParams_defaultSmoothing[p]);
+    }
+    ctxp->sampleRate = sampleRate;
+    ctxp->engineParamsFree = engineParamsFree;
+    return ctxp;
+}
+
+void EngineParams_free(struct EngineParams_context* ctxp)
+{
+    ctxp->engineParamsFree(ctxp);
+}
+
+void EngineParams_setSmoothing(struct EngineParams_context* ctxp, int parameter, float seconds)
+{
+    if(parameter < 0 || parameter >= ENGINEPARAMS_COUNT)
+    {
+        return;
+    }
+    ctxp->perSample[parameter] = EngineParams_perSample(ctxp->sampleRate,seconds);
+}
+
+void EngineParams_publish(struct EngineParams_context* ctxp, const struct EngineParams_set* set)
+{
+    ctxp->slot[ctxp->back] = *set;
+    //Release, so the set is all there before the audio thread can see the slot as fresh
+    int old = __atomic_exchange_n(&ctxp->middle,ctxp->back | ENGINEPARAMS_FRESH,__ATOMIC_ACQ_REL);
+    ctxp->back = old & ~ENGINEPARAMS_FRESH;
+}
+
+int EngineParams_acquire(struct EngineParams_context* ctxp)
+{
+    if(!(__atomic_load_n(&ctxp->middle,__ATOMIC_RELAXED) & ENGINEPARAMS_FRESH))
+    {
+        return FALSE;
+    }
+    //Only this thread clears the flag, so what comes back is still the fresh slot, or a newer one
+    int fresh = __atomic_exchange_n(&ctxp->middle,ctxp->front,__ATOMIC_ACQ_REL);
+    ctxp->front = fresh & ~ENGINEPARAMS_FRESH;
+    const struct EngineParams_set* set = &ctxp->slot[ctxp->front];
+    for(int p=0; p<ENGINEPARAMS_COUNT; p++)
+    {
+        ctxp->target[p] = set->value[p];
+    }
+    return TRUE;
+}
+
+/**
+ One pole per parameter, stepped once per call.  The caller ramps linearly between the values
+ it gets, so the glide is smooth within the block too.
+ */
+void EngineParams_advance(struct EngineParams_context* ctxp, int n, float* start, float* end)
+{
+    for(int p=0; p<ENGINEPARAMS_COUNT; p++)
+    {
+        float value = ctxp->current[p];
+        start[p] = value;
+        float distance = ctxp->target[p] - value;
+        if(distance != 0)
+        {
+            float perSample = ctxp->perSample[p];
+            float k = (perSample > 0) ? EngineParams_approach(n * perSample) : 1;
+            value += distance * k;
+            float left = ctxp->target[p] - value;
+            if(left < ENGINEPARAMS_SETTLED && left > -ENGINEPARAMS_SETTLED)
+            {
+                value = ctxp->target[p];
+            }
+            ctxp->current[p] = value;
+        }
+        end[p] = value;
+    }
+}
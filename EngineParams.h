@@ -0,0 +1,75 @@
+//
+//  EngineParams.h
+//  AlephOne
+//
+// This should remain a *pure* C library with no references to external libraries
+
+/*
+ * Patch parameters, handed from the UI thread to the audio thread without locks.
+ *
+ * Three copies of the parameter set are kept.  The UI fills the one it owns with a complete new
+ * set and swaps it into the middle slot with a single atomic exchange, marking it fresh.  At the
+ * start of each block the audio thread, if the middle slot is fresh, swaps it with the one it
+ * reads from, again with one exchange.  Neither side ever touches the slot the other is using,
+ * so a set is never read half written, and neither ever waits: the UI can publish as often as
+ * it likes, and the audio thread just picks up the latest.
+ *
+ * What the audio thread picks up is a target.  Each parameter glides towards its target with its
+ * own time constant, so a jump in the UI comes out as a smooth change.
+ */
+#define ENGINEPARAMS_W00 0
+#define ENGINEPARAMS_W01 1
+#define ENGINEPARAMS_W10 2
+#define ENGINEPARAMS_W11 3
+#define ENGINEPARAMS_GAIN 4
+#define ENGINEPARAMS_TUNE 5
+#define ENGINEPARAMS_COUNT 6
+
+/*
+ * value[ENGINEPARAMS_W00..W11] scale the corner waveforms of the expression square (sine,
+ * triangle, saw and square), 1 as designed.  GAIN scales the bank's gain, and TUNE (semitones)
+ * is added to every voice's pitch.
+ */
+struct EngineParams_set
+{
+    float value[ENGINEPARAMS_COUNT];
+};
+
+struct EngineParams_context;
+
+/*
+ * Fill a set with the defaults, which leave the engine sounding as it does without parameters.
+ */
+void EngineParams_defaults(struct EngineParams_set* set);
+
+/*
+ * The audio thread starts on initial (or the defaults, for NULL) without gliding to it.
+ */
+struct EngineParams_context* EngineParams_init(float sampleRate, const struct EngineParams_set* initial,
+                                               void* (*engineParamsAlloc)(unsigned long),
+                                               void (*engineParamsFree)(void*));
+
+void EngineParams_free(struct EngineParams_context* ctxp);
+
+/*
+ * Seconds for parameter to get about two thirds of the way to a new target.  Zero jumps.
+ * Set up before the audio thread starts; it is not handed over like the values are.
+ */
+void EngineParams_setSmoothing(struct EngineParams_context* ctxp, int parameter, float seconds);
+
+/*
+ * UI thread: make set the newest complete set.  It is copied; the caller keeps it.
+ */
+void EngineParams_publish(struct EngineParams_context* ctxp, const struct EngineParams_set* set);
+
+/*
+ * Audio thread, at the start of a block: take the newest published set as the targets, if there
+ * is one that hasn't been taken.  Returns TRUE if the targets changed.
+ */
+int EngineParams_acquire(struct EngineParams_context* ctxp);
+
+/*
+ * Audio thread: glide n samples towards the targets.  start and end (ENGINEPARAMS_COUNT wide)
+ * get the values at the start and end of those samples, for ramping across them.
+ */
+void EngineParams_advance(struct EngineParams_context* ctxp, int n, float* start, float* end);
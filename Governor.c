@@ -0,0 +1,192 @@
+//
+//  Governor.c
+//  AlephOne
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include "Governor.h"
+#include "VoiceBank.h"
+#include "Wavetable.h"
+#include <time.h>
+#include "EngineCommon.h"
+
+#define GOVERNOR_DEFAULT_BUDGET 0.5f
+//A block using more than this much of the budget steps down at once
+#define GOVERNOR_HIGH 0.8f
+//The smoothed load has to stay under this, for GOVERNOR_HOLD_SECONDS, to step up.  Low enough
+//that doubling the cost (the step from 2x to 4x oversampling) still lands under GOVERNOR_HIGH
+#define GOVERNOR_LOW 0.35f
+#define GOVERNOR_HOLD_SECONDS 0.5f
+#define GOVERNOR_SMOOTHING 0.1f
+
+struct Governor_tier
+{
+    int oversampling;
+    int interpolation;
+    int voiceCap;
+};
+
+static const struct Governor_tier Governor_tiers[GOVERNOR_TIERS] =
+{
+    {4, WAVETABLE_INTERPOLATE_LINEAR, VOICEMAX},
+    {2, WAVETABLE_INTERPOLATE_LINEAR, VOICEMAX},
+    {1, WAVETABLE_INTERPOLATE_LINEAR, VOICEMAX},
+    {1, WAVETABLE_INTERPOLATE_NEAREST, VOICEMAX},
+    {1, WAVETABLE_INTERPOLATE_NEAREST, 10},
+    {1, WAVETABLE_INTERPOLATE_NEAREST, 6}
+};
+
+struct Governor_context
+{
+    struct VoiceBank_context* bank;
+    float sampleRate;
+    float budget;
+    int enabled;
+    int best;
+    int worst;
+    int tier;
+    float load;
+    //Seconds the load has been low enough to step up
+    float calm;
+    long misses;
+    long blocks;
+    void (*governorFree)(void*);
+};
+
+static double Governor_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static void Governor_apply(struct Governor_context* ctxp, int tier)
+{
+    const struct Governor_tier* t = &Governor_tiers[tier];
+    ctxp->tier = tier;
+    ctxp->calm = 0;
+    VoiceBank_setOversampling(ctxp->bank,t->oversampling);
+    VoiceBank_setVoiceCap(ctxp->bank,t->voiceCap);
+    struct Wavetable_bank* wavetable = VoiceBank_getWavetable(ctxp->bank);
+    if(wavetable)
+    {
+        Wavetable_setInterpolation(wavetable,t->interpolation);
+    }
+}
+
+struct Governor_context* Governor_init(struct VoiceBank_context* bank, float sampleRate,
+                                       void* (*governorAlloc)(unsigned long),
+                                       void (*governorFree)(void*))
+{
+    struct Governor_context* ctxp = governorAlloc(sizeof(struct Governor_context));
+    ctxp->bank = bank;
+    ctxp->sampleRate = sampleRate;
+    ctxp->budget = GOVERNOR_DEFAULT_BUDGET;
+    ctxp->enabled = TRUE;
+    ctxp->best = 0;
+    ctxp->worst = GOVERNOR_TIERS - 1;
+    ctxp->load = 0;
+    ctxp->misses = 0;
+    ctxp->blocks = 0;
+    ctxp->governorFree = governorFree;
+    Governor_apply(ctxp,0);
+    return ctxp;
+}
+
+void Governor_free(struct Governor_context* ctxp)
+{
+    ctxp->governorFree(ctxp);
+}
+
+void Governor_render(struct Governor_context* ctxp, float* left, float* right, int n)
+{
+    double started = Governor_now();
+    VoiceBank_render(ctxp->bank,left,right,n);
+    double elapsed = Governor_now() - started;
+
+    float period = n / ctxp->sampleRate;
+    float load = elapsed / (period * ctxp->budget);
+    ctxp->load += (load - ctxp->load) * GOVERNOR_SMOOTHING;
+    ctxp->blocks++;
+    if(load > 1)
+    {
+        ctxp->misses++;
+    }
+    if(!ctxp->enabled)
+    {
+        return;
+    }
+    if(load > GOVERNOR_HIGH)
+    {
+        if(ctxp->tier < ctxp->worst)
+        {
+            Governor_apply(ctxp,ctxp->tier + 1);
+            //Judge the new tier on its own blocks
+            ctxp->load = 0;
+        }
+        ctxp->calm = 0;
+    }
+    else if(ctxp->load < GOVERNOR_LOW)
+    {
+        ctxp->calm += period;
+        if(ctxp->calm >= GOVERNOR_HOLD_SECONDS && ctxp->tier > ctxp->best)
+        {
+            Governor_apply(ctxp,ctxp->tier - 1);
+        }
+    }
+    else
+    {
+        ctxp->calm = 0;
+    }
+}
+
+void Governor_setBudget(struct Governor_context* ctxp, float fraction)
+{
+    ctxp->budget = fraction;
+}
+
+void Governor_setTierRange(struct Governor_context* ctxp, int best, int worst)
+{
+    if(best < 0)best = 0;
+    if(worst > GOVERNOR_TIERS - 1)worst = GOVERNOR_TIERS - 1;
+    if(worst < best)worst = best;
+    ctxp->best = best;
+    ctxp->worst = worst;
+    if(ctxp->tier < best)
+    {
+        Governor_apply(ctxp,best);
+    }
+    if(ctxp->tier > worst)
+    {
+        Governor_apply(ctxp,worst);
+    }
+}
+
+void Governor_setEnabled(struct Governor_context* ctxp, int enabled)
+{
+    ctxp->enabled = enabled;
+    if(!enabled)
+    {
+        Governor_apply(ctxp,ctxp->best);
+    }
+}
+
+int Governor_getTier(struct Governor_context* ctxp)
+{
+    return ctxp->tier;
+}
+
+float Governor_getLoad(struct Governor_context* ctxp)
+{
+    return ctxp->load;
+}
+
+long Governor_getDeadlineMisses(struct Governor_context* ctxp)
+{
+    return ctxp->misses;
+}
+
+long Governor_getBlocks(struct Governor_context* ctxp)
+{
+    return ctxp->blocks;
+}
@@ -0,0 +1,61 @@
+//
+//  Governor.h
+//  AlephOne
+//
+// Keeps a VoiceBank inside its time budget by trading quality for speed.
+//
+// Every block is timed against its deadline.  A block that comes close steps quality down one
+// tier straight away, since the next one is likely to be as heavy (a chord has just gone down).
+// Quality only comes back up a tier after the load has stayed well under the budget for a
+// while, so the governor doesn't flap between tiers on a steady load near a threshold.  Playing
+// slightly worse for a moment is better than a dropout.
+//
+// Like SMF, this uses the OS clock directly.
+
+/*
+ * From best to cheapest.  Each tier sets the kernel's oversampling, the wavetables'
+ * interpolation (when the bank uses them) and how many voices may sound.
+ */
+#define GOVERNOR_TIERS 6
+
+struct Governor_context;
+struct VoiceBank_context;
+
+struct Governor_context* Governor_init(struct VoiceBank_context* bank, float sampleRate,
+                                       void* (*governorAlloc)(unsigned long),
+                                       void (*governorFree)(void*));
+
+void Governor_free(struct Governor_context* ctxp);
+
+/*
+ * Render the bank, as VoiceBank_render, timing it and adjusting the tier for the next block.
+ */
+void Governor_render(struct Governor_context* ctxp, float* left, float* right, int n);
+
+/*
+ * The share of each block's period the bank may use, leaving the rest for the host and
+ * other plugins.  Defaults to 0.5.  A block over budget is a deadline miss.
+ */
+void Governor_setBudget(struct Governor_context* ctxp, float fraction);
+
+/*
+ * Which tiers may be used; best may be raised to cap quality (tier 0 oversamples 4x, which many
+ * patches don't need) and worst lowered to stop voices being culled.  Setting a range also
+ * moves the current tier into it.
+ */
+void Governor_setTierRange(struct Governor_context* ctxp, int best, int worst);
+
+/*
+ * Switch the governor off, rendering at the best tier whatever the load (still counting misses).
+ */
+void Governor_setEnabled(struct Governor_context* ctxp, int enabled);
+
+int Governor_getTier(struct Governor_context* ctxp);
+
+/*
+ * Render time over budget, smoothed over recent blocks.
+ */
+float Governor_getLoad(struct Governor_context* ctxp);
+
+long Governor_getDeadlineMisses(struct Governor_context* ctxp);
+long Governor_getBlocks(struct Governor_context* ctxp);
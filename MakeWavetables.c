@@ -0,0 +1,49 @@
+//
+//  MakeWavetables.c
+//  AlephOne
+//
+// Build step: precompute the band-limited wavetable banks that the engine maps at startup.
+//
+//   MakeWavetables wavetables 44100 48000 96000
+//
+// writes wavetables-44100.wt and so on, one bank per sample rate.
+#define _POSIX_C_SOURCE 200809L
+
+#include "WavetableFile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double MakeWavetables_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        fprintf(stderr,"usage: %s prefix sampleRate...\n",argv[0]);
+        return 1;
+    }
+    for(int i=2; i<argc; i++)
+    {
+        float sampleRate = atof(argv[i]);
+        if(sampleRate <= 0)
+        {
+            fprintf(stderr,"%s: bad sample rate %s\n",argv[0],argv[i]);
+            return 1;
+        }
+        char fname[4096];
+        snprintf(fname,sizeof(fname),"%s-%.0f.wt",argv[1],sampleRate);
+        double started = MakeWavetables_now();
+        if(!WavetableFile_write(fname,sampleRate,printf))
+        {
+            return 1;
+        }
+        printf("%s: %.1f ms\n",fname,(MakeWavetables_now() - started)*1e3);
+    }
+    return 0;
+}
@@ -0,0 +1,381 @@
+//
+//  OfflineRender.c
+//  AlephOne
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include "OfflineRender.h"
+#include "SMF.h"
+#include "DeMIDI.h"
+#include "VoiceBank.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include "FretlessCommon.h"
+
+//VoiceBank holds 256 pending updates per render; a block is cut short before it could run out
+#define OFFLINERENDER_EVENTMAX 240
+//stdio buffer for the output, so the disk sees a few large writes instead of one per block
+#define OFFLINERENDER_BUFFER (1<<20)
+#define OFFLINERENDER_CHANNELS 2
+#define OFFLINERENDER_WAVE_FORMAT_IEEE_FLOAT 3
+//RIFF header, an 18 byte fmt chunk, a fact chunk and the data chunk header
+#define OFFLINERENDER_WAV_HEADER 58
+//The self test crowds more than OFFLINERENDER_EVENTMAX updates between two samples
+#define OFFLINERENDER_TEST_RATE 48000
+#define OFFLINERENDER_TEST_TICK 1000.5
+#define OFFLINERENDER_TEST_BENDS 300
+
+struct OfflineRender_session
+{
+    struct VoiceBank_context* bank;
+    FILE* out;
+    float sampleRate;
+    float left[OFFLINERENDER_BLOCK];
+    float right[OFFLINERENDER_BLOCK];
+    float frames[OFFLINERENDER_CHANNELS*OFFLINERENDER_BLOCK];
+    //Updates scheduled on the bank since it last rendered
+    int updates;
+    double lastEvent;
+    long framesWritten;
+    int failed;
+};
+
+//SMF_play and DeMIDI have no user pointer, so the session being rendered is held here
+static struct OfflineRender_session* rendering = NULL;
+
+static double OfflineRender_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static void OfflineRender_put16(unsigned char* p, unsigned int v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void OfflineRender_put32(unsigned char* p, unsigned long v)
+{
+    OfflineRender_put16(p,v & 0xFFFF);
+    OfflineRender_put16(p+2,(v >> 16) & 0xFFFF);
+}
+
+static void OfflineRender_putTag(unsigned char* p, const char* tag)
+{
+    for(int i=0; i<4; i++)
+    {
+        p[i] = tag[i];
+    }
+}
+
+/**
+ WAVE is little endian.  Written once with zero lengths at the start, and again with the real
+ ones when the data is done.
+ */
+static int OfflineRender_writeHeader(FILE* out, float sampleRate, long frames)
+{
+    unsigned long dataBytes = frames * OFFLINERENDER_CHANNELS * sizeof(float);
+    unsigned char h[OFFLINERENDER_WAV_HEADER];
+    OfflineRender_putTag(h,"RIFF");
+    OfflineRender_put32(h+4,OFFLINERENDER_WAV_HEADER - 8 + dataBytes);
+    OfflineRender_putTag(h+8,"WAVE");
+    OfflineRender_putTag(h+12,"fmt ");
+    OfflineRender_put32(h+16,18);
+    OfflineRender_put16(h+20,OFFLINERENDER_WAVE_FORMAT_IEEE_FLOAT);
+    OfflineRender_put16(h+22,OFFLINERENDER_CHANNELS);
+    OfflineRender_put32(h+24,(unsigned long)sampleRate);
+    OfflineRender_put32(h+28,(unsigned long)sampleRate * OFFLINERENDER_CHANNELS * sizeof(float));
+    OfflineRender_put16(h+32,OFFLINERENDER_CHANNELS * sizeof(float));
+    OfflineRender_put16(h+34,8 * sizeof(float));
+    OfflineRender_put16(h+36,0);
+    OfflineRender_putTag(h+38,"fact");
+    OfflineRender_put32(h+42,4);
+    OfflineRender_put32(h+46,frames);
+    OfflineRender_putTag(h+50,"data");
+    OfflineRender_put32(h+54,dataBytes);
+    return fwrite(h,sizeof(h),1,out) == 1;
+}
+
+static int OfflineRender_isLittleEndian()
+{
+    union
+    {
+        unsigned int i;
+        unsigned char c[sizeof(unsigned int)];
+    } probe;
+    probe.i = 1;
+    return probe.c[0] == 1;
+}
+
+static void OfflineRender_swap(float* f)
+{
+    unsigned char* b = (unsigned char*)f;
+    unsigned char t = b[0];
+    b[0] = b[3];
+    b[3] = t;
+    t = b[1];
+    b[1] = b[2];
+    b[2] = t;
+}
+
+/**
+ Render and write n samples, n up to OFFLINERENDER_BLOCK.
+ */
+static void OfflineRender_block(struct OfflineRender_session* s, int n)
+{
+    VoiceBank_render(s->bank,s->left,s->right,n);
+    s->updates = 0;
+    for(int i=0; i<n; i++)
+    {
+        s->frames[2*i] = s->left[i];
+        s->frames[2*i+1] = s->right[i];
+    }
+    if(!OfflineRender_isLittleEndian())
+    {
+        for(int i=0; i<OFFLINERENDER_CHANNELS*n; i++)
+        {
+            OfflineRender_swap(&s->frames[i]);
+        }
+    }
+    if(fwrite(s->frames,OFFLINERENDER_CHANNELS*sizeof(float),n,s->out) != (size_t)n)
+    {
+        s->failed = TRUE;
+    }
+    s->framesWritten += n;
+}
+
+/**
+ Render everything before sample end.
+ */
+static void OfflineRender_until(struct OfflineRender_session* s, long end)
+{
+    long remaining = end - (long)VoiceBank_getTime(s->bank);
+    while(remaining > 0 && !s->failed)
+    {
+        int n = (remaining < OFFLINERENDER_BLOCK) ? (int)remaining : OFFLINERENDER_BLOCK;
+        OfflineRender_block(s,n);
+        remaining -= n;
+    }
+}
+
+static void OfflineRender_rawEngine(int midiChannel,int doNoteAttack,float pitch,float volVal,int midiExprParm,int midiExpr)
+{
+    rendering->updates++;
+    VoiceBank_rawEngine(midiChannel,doNoteAttack,pitch,volVal,midiExprParm,midiExpr);
+}
+
+/**
+ The block starting at the bank's clock collects events until one comes after it, then is
+ rendered along with any empty blocks up to the new event.
+ */
+static void OfflineRender_event(double sampleTime,int status,const unsigned char* data,int length)
+{
+    struct OfflineRender_session* s = rendering;
+    long now = (long)VoiceBank_getTime(s->bank);
+    if(sampleTime >= now + OFFLINERENDER_BLOCK)
+    {
+        OfflineRender_until(s,now + (long)((sampleTime - now) / OFFLINERENDER_BLOCK) * OFFLINERENDER_BLOCK);
+    }
+    else if(s->updates >= OFFLINERENDER_EVENTMAX)
+    {
+        //Events crowded onto the bank's current sample stay there; the bank keeps them in order
+        OfflineRender_until(s,(long)sampleTime);
+    }
+    s->lastEvent = sampleTime;
+    SMF_putDeMIDI(sampleTime,status,data,length);
+}
+
+double OfflineRender_file(const char* midiName, const char* wavName, float sampleRate,
+                          int (*logger)(const char*,...))
+{
+    double started = OfflineRender_now();
+    struct SMF_file* smf = SMF_open(midiName,logger);
+    if(!smf)
+    {
+        return -1;
+    }
+    struct OfflineRender_session* s = malloc(sizeof(struct OfflineRender_session));
+    char* buffer = malloc(OFFLINERENDER_BUFFER);
+    FILE* out = fopen(wavName,"wb");
+    if(!s || !buffer || !out)
+    {
+        logger(out ? "OfflineRender_file: out of memory\n" : "OfflineRender_file: cannot create %s\n",wavName);
+        if(out)fclose(out);
+        free(buffer);
+        free(s);
+        SMF_close(smf);
+        return -1;
+    }
+    setvbuf(out,buffer,_IOFBF,OFFLINERENDER_BUFFER);
+    s->bank = VoiceBank_init(sampleRate,malloc,free);
+    s->out = out;
+    s->sampleRate = sampleRate;
+    s->updates = 0;
+    s->lastEvent = 0;
+    s->framesWritten = 0;
+    s->failed = !OfflineRender_writeHeader(out,sampleRate,0);
+
+    rendering = s;
+    VoiceBank_listen(s->bank);
+    DeMIDI_start(OfflineRender_rawEngine);
+    SMF_play(smf,sampleRate,OfflineRender_event);
+    OfflineRender_until(s,(long)s->lastEvent + 1 + (long)(OFFLINERENDER_TAIL_SECONDS * sampleRate));
+    rendering = NULL;
+
+    //Go back and fill in the lengths
+    if(!s->failed)
+    {
+        s->failed = fseek(out,0,SEEK_SET) != 0 || !OfflineRender_writeHeader(out,sampleRate,s->framesWritten);
+    }
+    s->failed |= (fclose(out) != 0);
+    double seconds = s->framesWritten / sampleRate;
+    double elapsed = OfflineRender_now() - started;
+    if(s->failed)
+    {
+        logger("OfflineRender_file: cannot write %s\n",wavName);
+        seconds = -1;
+    }
+    else
+    {
+        logger("%s: %.1f seconds of audio in %.3f seconds, %.0fx realtime\n",wavName,seconds,elapsed,seconds/elapsed);
+    }
+    VoiceBank_free(s->bank);
+    free(s);
+    free(buffer);
+    SMF_close(smf);
+    return seconds;
+}
+
+int OfflineRender_selfTest(int (*fail)(const char*,...), void (*passed)())
+{
+    struct OfflineRender_session* s = malloc(sizeof(struct OfflineRender_session));
+    s->bank = VoiceBank_init(OFFLINERENDER_TEST_RATE,malloc,free);
+    s->out = tmpfile();
+    s->sampleRate = OFFLINERENDER_TEST_RATE;
+    s->updates = 0;
+    s->lastEvent = 0;
+    s->framesWritten = 0;
+    s->failed = (s->out == NULL);
+
+    rendering = s;
+    VoiceBank_listen(s->bank);
+    DeMIDI_start(OfflineRender_rawEngine);
+    //A note, more bends than the bank can hold, and the release, all between the same two samples
+    unsigned char data[2] = {60,100};
+    OfflineRender_event(OFFLINERENDER_TEST_TICK,0x90,data,2);
+    for(int i=0; i<OFFLINERENDER_TEST_BENDS; i++)
+    {
+        data[0] = 0;
+        data[1] = 32 + i % 64;
+        OfflineRender_event(OFFLINERENDER_TEST_TICK,0xE0,data,2);
+    }
+    data[0] = 60;
+    data[1] = 0;
+    OfflineRender_event(OFFLINERENDER_TEST_TICK,0x80,data,2);
+    OfflineRender_until(s,(long)s->lastEvent + 1 + (long)(OFFLINERENDER_TAIL_SECONDS * s->sampleRate));
+    rendering = NULL;
+
+    int ok = !s->failed && VoiceBank_getActive(s->bank) == 0;
+    if(s->failed)
+    {
+        fail("OfflineRender_selfTest: cannot write a temporary file\n");
+    }
+    else if(!ok)
+    {
+        fail("OfflineRender_selfTest: the release of a note with %d updates on its last sample was applied out of order\n",
+             OFFLINERENDER_TEST_BENDS + 2);
+    }
+    else
+    {
+        passed();
+    }
+    if(s->out)fclose(s->out);
+    VoiceBank_free(s->bank);
+    free(s);
+    return ok;
+}
+
+int OfflineRender_files(const char* const* midiNames, const char* const* wavNames, int count, int jobs,
+                        float sampleRate, int (*logger)(const char*,...))
+{
+    if(jobs <= 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = (cores > 0) ? (int)cores : 1;
+    }
+    pid_t* children = malloc(count * sizeof(pid_t));
+    if(!children)
+    {
+        logger("OfflineRender_files: out of memory\n");
+        return 0;
+    }
+    double started = OfflineRender_now();
+    double audio = 0;
+    int succeeded = 0;
+    int running = 0;
+    int next = 0;
+    while(next < count || running > 0)
+    {
+        if(next < count && running < jobs)
+        {
+            //Anything still buffered would be written again by the child
+            fflush(NULL);
+            pid_t pid = fork();
+            if(pid == 0)
+            {
+                double seconds = OfflineRender_file(midiNames[next],wavNames[next],sampleRate,logger);
+                fflush(NULL);
+                _exit(seconds < 0 ? 1 : 0);
+            }
+            if(pid < 0)
+            {
+                logger("OfflineRender_files: cannot fork, rendering %s in this process\n",midiNames[next]);
+                double seconds = OfflineRender_file(midiNames[next],wavNames[next],sampleRate,logger);
+                if(seconds >= 0)
+                {
+                    audio += seconds;
+                    succeeded++;
+                }
+            }
+            children[next] = pid;
+            running += (pid > 0);
+            next++;
+            continue;
+        }
+        int status;
+        pid_t pid = waitpid(-1,&status,0);
+        if(pid < 0)
+        {
+            break;
+        }
+        running--;
+        int i = 0;
+        while(i < next && children[i] != pid)
+        {
+            i++;
+        }
+        struct stat st;
+        if(WIFEXITED(status) && WEXITSTATUS(status) == 0 && stat(wavNames[i],&st) == 0)
+        {
+            //The child's length is in its file
+            audio += (st.st_size - OFFLINERENDER_WAV_HEADER) / (OFFLINERENDER_CHANNELS * sizeof(float) * (double)sampleRate);
+            succeeded++;
+        }
+        else
+        {
+            logger("OfflineRender_files: %s failed\n",midiNames[i]);
+        }
+    }
+    double elapsed = OfflineRender_now() - started;
+    logger("OfflineRender_files: %d of %d files, %.1f seconds of audio in %.3f seconds with %d jobs, %.0fx realtime\n",
+           succeeded,count,audio,elapsed,jobs,audio/elapsed);
+    free(children);
+    return succeeded;
+}
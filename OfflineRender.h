@@ -0,0 +1,43 @@
+//
+//  OfflineRender.h
+//  AlephOne
+//
+// Render recorded sessions (Standard MIDI Files) through DeMIDI and a VoiceBank to 32 bit float
+// WAV, as fast as the machine allows, for mastering and regression listening.
+//
+// Events are taken from the file in time order and scheduled on the bank, which renders in large
+// blocks and splits them at each event, so the output is sample for sample what the engine would
+// have played live with the same input.  The audio is streamed out through a large stdio buffer;
+// nothing is held in memory beyond one block.
+//
+// DeMIDI is one instance per process, so files are rendered in parallel by forking a process per
+// file rather than by threads.
+//
+// Like SMF, this is a host side utility and uses the OS directly (stdio, fork, clock_gettime).
+
+//Samples rendered per VoiceBank_render call, when no event falls sooner
+#define OFFLINERENDER_BLOCK 8192
+//Silence rendered after the last event, for releases to finish
+#define OFFLINERENDER_TAIL_SECONDS 0.5
+
+/*
+ * Render midiName to wavName (stereo, 32 bit float) at sampleRate.  Logs the length and the
+ * render speed as a multiple of realtime.
+ * Returns the seconds of audio written, or -1 (after logging why) if either file can't be used.
+ */
+double OfflineRender_file(const char* midiName, const char* wavName, float sampleRate,
+                          int (*logger)(const char*,...));
+
+/*
+ * Render count files, midiNames[i] to wavNames[i], running up to jobs of them at once in child
+ * processes (0 for one per online core).  Logs the total audio rendered and the overall multiple of realtime.
+ * Returns how many were rendered successfully.
+ */
+int OfflineRender_files(const char* const* midiNames, const char* const* wavNames, int count, int jobs,
+                        float sampleRate, int (*logger)(const char*,...));
+
+/*
+ * Render a note whose release comes after more updates on the same sample than the bank can
+ * queue, and fail unless the note has ended.  Returns TRUE if it passed.
+ */
+int OfflineRender_selfTest(int (*fail)(const char*,...), void (*passed)());
@@ -0,0 +1,133 @@
+//
+//  Oversample.c
+//  AlephOne
+//
+
+#include "Oversample.h"
+#include "EngineCommon.h"
+
+/**
+ The odd-tap coefficients c[k] of each half-band filter, at offsets +-(2k+1) from the center, laid
+ out as c[P-1]..c[0],c[0]..c[P-1] to line up with 2P consecutive even input samples.  Scaled so
+ that they sum to 1/2, which with the center tap gives unity gain at DC.
+ */
+static const float Oversample_steep[2*OVERSAMPLE_STEEP_PHASES] __attribute__((aligned(16))) =
+{
+    -3.236778986e-05f, 2.146022812e-04f, -6.899972485e-04f, 1.690635467e-03f,
+    -3.539435262e-03f, 6.670786169e-03f, -1.168527653e-02f, 1.951150296e-02f,
+    -3.190591831e-02f, 5.323910908e-02f, -9.953366729e-02f, 3.160600265e-01f,
+    3.160600265e-01f, -9.953366729e-02f, 5.323910908e-02f, -3.190591831e-02f,
+    1.951150296e-02f, -1.168527653e-02f, 6.670786169e-03f, -3.539435262e-03f,
+    1.690635467e-03f, -6.899972485e-04f, 2.146022812e-04f, -3.236778986e-05f
+};
+
+static const float Oversample_wide[2*OVERSAMPLE_WIDE_PHASES] __attribute__((aligned(16))) =
+{
+    -6.767299062e-05f, 1.578727255e-03f, -8.359864811e-03f, 2.820193451e-02f,
+    -7.992506506e-02f, 3.085719411e-01f, 3.085719411e-01f, -7.992506506e-02f,
+    2.820193451e-02f, -8.359864811e-03f, 1.578727255e-03f, -6.767299062e-05f
+};
+
+/**
+ One halving.  The input is split into its even and odd samples, each kept after the last
+ samples of the previous piece: 2P-1 evens for the dot product, P odds for the center tap.
+ */
+struct Oversample_stage
+{
+    const float* weights;
+    int phases;
+    float even[2*OVERSAMPLE_STEEP_PHASES - 1 + 2*OVERSAMPLE_CHUNK];
+    float odd[OVERSAMPLE_STEEP_PHASES + 2*OVERSAMPLE_CHUNK];
+};
+
+struct Oversample_decimator
+{
+    //4x goes through wide then steep, 2x only through steep
+    struct Oversample_stage wide;
+    struct Oversample_stage steep;
+    float middle[2*OVERSAMPLE_CHUNK];
+    void (*oversampleFree)(void*);
+};
+
+struct Oversample_decimator* Oversample_init(void* (*oversampleAlloc)(unsigned long),
+                                             void (*oversampleFree)(void*))
+{
+    struct Oversample_decimator* d = oversampleAlloc(sizeof(struct Oversample_decimator));
+    d->wide.weights = Oversample_wide;
+    d->wide.phases = OVERSAMPLE_WIDE_PHASES;
+    d->steep.weights = Oversample_steep;
+    d->steep.phases = OVERSAMPLE_STEEP_PHASES;
+    d->oversampleFree = oversampleFree;
+    Oversample_reset(d);
+    return d;
+}
+
+void Oversample_free(struct Oversample_decimator* d)
+{
+    d->oversampleFree(d);
+}
+
+static void Oversample_resetStage(struct Oversample_stage* stage)
+{
+    for(int i=0; i<2*stage->phases - 1; i++)
+    {
+        stage->even[i] = 0;
+    }
+    for(int i=0; i<stage->phases; i++)
+    {
+        stage->odd[i] = 0;
+    }
+}
+
+void Oversample_reset(struct Oversample_decimator* d)
+{
+    Oversample_resetStage(&d->wide);
+    Oversample_resetStage(&d->steep);
+}
+
+//2n samples of in to n of out, n up to 2*OVERSAMPLE_CHUNK
+static void Oversample_halve(struct Oversample_stage* stage, const float* in, float* out, int n)
+{
+    int taps = 2*stage->phases;
+    int evenHistory = taps - 1;
+    int oddHistory = stage->phases;
+    for(int i=0; i<n; i++)
+    {
+        stage->even[evenHistory + i] = in[2*i];
+        stage->odd[oddHistory + i] = in[2*i + 1];
+    }
+    for(int m=0; m<n; m++)
+    {
+        Engine_vf sum = Engine_splat(0);
+        for(int j=0; j<taps; j+=ENGINE_LANES)
+        {
+            Engine_vf x;
+            __builtin_memcpy(&x,&stage->even[m + j],sizeof(Engine_vf));
+            sum += x * *(const Engine_vf*)&stage->weights[j];
+        }
+        out[m] = 0.5f*stage->odd[m] + sum[0] + sum[1] + sum[2] + sum[3];
+    }
+    __builtin_memmove(stage->even,&stage->even[n],evenHistory*sizeof(float));
+    __builtin_memmove(stage->odd,&stage->odd[n],oddHistory*sizeof(float));
+}
+
+void Oversample_decimate(struct Oversample_decimator* d, int factor, const float* in, float* out, int n)
+{
+    for(int done=0; done<n; done+=OVERSAMPLE_CHUNK)
+    {
+        int length = (n - done < OVERSAMPLE_CHUNK) ? n - done : OVERSAMPLE_CHUNK;
+        if(factor == 4)
+        {
+            Oversample_halve(&d->wide,&in[4*done],d->middle,2*length);
+            Oversample_halve(&d->steep,d->middle,&out[done],length);
+        }
+        else if(factor == 2)
+        {
+            Oversample_halve(&d->steep,&in[2*done],&out[done],length);
+        }
+        else
+        {
+            __builtin_memcpy(&out[done],&in[done],length*sizeof(float));
+        }
+    }
+}
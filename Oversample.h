@@ -0,0 +1,40 @@
+//
+//  Oversample.h
+//  AlephOne
+//
+
+/*
+ * Decimation back to the output rate for a mix bus that was rendered at 2x or 4x.
+ *
+ * Each halving is a half-band FIR: every other coefficient is zero except the center one, which
+ * is 1/2, so only the taps on one polyphase branch need multiplying.  That branch is symmetric,
+ * and is stored unfolded so that each output is one contiguous vector dot product over the
+ * even input samples.  The coefficient sets are Kaiser windowed and fixed:
+ *   OVERSAMPLE_STEEP_PHASES (47 taps) for the last halving, flat to 0.39 of the output rate,
+ *   with 78dB of rejection from 0.61;
+ *   OVERSAMPLE_WIDE_PHASES (23 taps) for the first halving of 4x, where everything above the
+ *   final output band will be removed again anyway, with 79dB of rejection.
+ * The delay is 11.5 output samples at 2x and 14.25 at 4x.
+ */
+#define OVERSAMPLE_MAX 4
+#define OVERSAMPLE_STEEP_PHASES 12
+#define OVERSAMPLE_WIDE_PHASES 6
+//Decimation is done in pieces of up to this many output samples
+#define OVERSAMPLE_CHUNK 128
+
+struct Oversample_decimator;
+
+struct Oversample_decimator* Oversample_init(void* (*oversampleAlloc)(unsigned long),
+                                             void (*oversampleFree)(void*));
+
+void Oversample_free(struct Oversample_decimator* d);
+
+/*
+ * Clear the filter history, for when the factor changes or the stream restarts.
+ */
+void Oversample_reset(struct Oversample_decimator* d);
+
+/*
+ * Filter n*factor samples of in down to n samples of out.  A factor of 1 copies.
+ */
+void Oversample_decimate(struct Oversample_decimator* d, int factor, const float* in, float* out, int n);
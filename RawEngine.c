@@ -0,0 +1,160 @@
+//
+//  RawEngine.c
+//  AlephOne
+//
+// This should remain a *pure* C library with no references to external libraries
+
+#include "RawEngine.h"
+#include "RawEngineKernel.h"
+#include "EngineMath.h"
+
+#define RAWENGINE_TOLERANCE 1e-5f
+#define RAWENGINE_TESTLENGTH 1000
+
+static float RawEngine_sineScalar(float x)
+{
+    float t = x*2 - 1;
+    float at = (t < 0) ? -t : t;
+    float y = 4*t*(1 - at);
+    float ay = (y < 0) ? -y : y;
+    return -(0.225f*(y*ay - y) + y);
+}
+
+static float RawEngine_triangleScalar(float x)
+{
+    float d = x - 0.5f;
+    return 1 - 4*((d < 0) ? -d : d);
+}
+
+static float RawEngine_sawScalar(float x)
+{
+    return x*2 - 1;
+}
+
+static float RawEngine_squareScalar(float x)
+{
+    return (x < 0.5f) ? 1 : -1;
+}
+
+void RawEngine_initVoice(struct RawEngine_voice* v)
+{
+    v->phase = 0;
+    v->cyclesPerSample = 0;
+    v->loD = 1;
+    v->loE = 1;
+    v->loPitch = 1;
+    v->hiPitch = 0;
+}
+
+void RawEngine_setPitch(struct RawEngine_voice* v, float pitch, float sampleRate)
+{
+    Engine_vf p = Engine_splat(pitch);
+    Engine_vf increment = EngineMath_exp2((p - 69)*(1.0f/12)) * (440 / sampleRate);
+    v->cyclesPerSample = increment[0];
+    v->hiPitch = RawEngine_hiPitch(p)[0];
+    v->loPitch = 1 - v->hiPitch;
+}
+
+//Keep the phase in [0,1) so that float precision doesn't run out on long notes
+static void RawEngine_advance(struct RawEngine_voice* v, int n)
+{
+    float cycles = n*v->cyclesPerSample + v->phase;
+    v->phase = cycles - (int)cycles;
+    if(v->phase < 0)
+    {
+        v->phase += 1;
+    }
+}
+
+void RawEngine_render(struct RawEngine_voice* v, float* out, int n)
+{
+    const Engine_vf loD = Engine_splat(v->loD);
+    const Engine_vf loE = Engine_splat(v->loE);
+    const Engine_vf loPitch = Engine_splat(v->loPitch);
+    const Engine_vf hiPitch = Engine_splat(v->hiPitch);
+    const float cyclesPerSample = v->cyclesPerSample;
+    const float phase = v->phase;
+    Engine_vf i = {0,1,2,3};
+    for(int s=0; s<n; s+=ENGINE_LANES)
+    {
+        Engine_vf cycles = i*cyclesPerSample + phase;
+        Engine_vf unAliased = RawEngine_kernel(RawEngine_frac(cycles),loD,loE,loPitch,hiPitch);
+        int remaining = n - s;
+        if(remaining >= ENGINE_LANES)
+        {
+            __builtin_memcpy(&out[s],&unAliased,sizeof(Engine_vf));
+        }
+        else
+        {
+            for(int l=0; l<remaining; l++)
+            {
+                out[s+l] = unAliased[l];
+            }
+        }
+        i += ENGINE_LANES;
+    }
+    RawEngine_advance(v,n);
+}
+
+void RawEngine_renderScalar(struct RawEngine_voice* v, float* out, int n)
+{
+    for(int i=0; i<n; i++)
+    {
+        float cycles = i*v->cyclesPerSample + v->phase;
+        float cycleLocation = cycles - (float)((int)cycles - (cycles < (int)cycles));
+        float fundamental = RawEngine_sineScalar(cycleLocation);
+        float w00 = fundamental;
+        float w01 = RawEngine_triangleScalar(cycleLocation);
+        float w10 = RawEngine_sawScalar(cycleLocation);
+        float w11 = RawEngine_squareScalar(cycleLocation);
+        float hiD = v->loD + RAWENGINE_NEGONE;
+        float hiE = v->loE + RAWENGINE_NEGONE;
+        float loExpress = w00*v->loD + w01*hiD;
+        float hiExpress = w10*v->loD + w11*hiD;
+        float expressed = loExpress*v->loE + hiExpress*hiE;
+        out[i] = fundamental*v->hiPitch + expressed*v->loPitch;
+    }
+    RawEngine_advance(v,n);
+}
+
+float RawEngine_selfTest(int (*fail)(const char*,...), void (*passed)())
+{
+    float block[RAWENGINE_TESTLENGTH];
+    float reference[RAWENGINE_TESTLENGTH];
+    float worst = 0;
+    for(int note=0; note<128; note+=7)
+    {
+        for(int corner=0; corner<4; corner++)
+        {
+            struct RawEngine_voice a;
+            struct RawEngine_voice b;
+            RawEngine_initVoice(&a);
+            RawEngine_setPitch(&a,note + 0.37f,48000);
+            a.loD = (corner & 1) ? 0.25f : 0.9f;
+            a.loE = (corner & 2) ? 0.1f : 0.6f;
+            a.phase = note / 128.0f;
+            b = a;
+            //Odd block lengths so that the partial tail gets exercised too
+            for(int length=1; length<=RAWENGINE_TESTLENGTH; length+=333)
+            {
+                RawEngine_render(&a,block,length);
+                RawEngine_renderScalar(&b,reference,length);
+                for(int i=0; i<length; i++)
+                {
+                    float d = block[i] - reference[i];
+                    d = (d < 0) ? -d : d;
+                    worst = (d > worst) ? d : worst;
+                }
+            }
+        }
+    }
+    if(worst > RAWENGINE_TOLERANCE)
+    {
+        fail("RawEngine_selfTest: block and scalar renders differ by %f\n",worst);
+    }
+    else
+    {
+        passed();
+    }
+    return worst;
+}
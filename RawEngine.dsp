@@ -1,13 +1,14 @@
 ( do
-    (in w00 w01 w10 w11 loD loE loPitch hiPitch cyclesPerSample i phase negone x y)
+    (in w00 w01 w10 w11 fundamental loD loE loPitch hiPitch cyclesPerSample i phase negone x y)
+    (scalar cyclesPerSample phase negone)
     (vset z (vadd x y))
     (vset hiE (vsadd loE negone)) 
     (vset hiD (vsadd loD negone)) 
     (vset cycles (vsadd (vsmul i cyclesPerSample) phase))
-    (vset cycleLocation (vfrac cycles cycles))
-    (vset loExpress (vadd (vmul w00 loD) (vmul w01 hiD))
-    (vset hiExpress (vadd (vmul w10 loD) (vmul w11 hiD))
-    (vset expressed (vadd (vmul loExpress loE) (vmul hiExpress hiE))
+    (vset cycleLocation (vfrac cycles))
+    (vset loExpress (vadd (vmul w00 loD) (vmul w01 hiD)))
+    (vset hiExpress (vadd (vmul w10 loD) (vmul w11 hiD)))
+    (vset expressed (vadd (vmul loExpress loE) (vmul hiExpress hiE)))
     (vset unAliased (vadd (vmul fundamental hiPitch) (vmul expressed loPitch)))
-    (out unAliased z)
-)
\ No newline at end of file
+    (out unAliased z cycleLocation)
+)
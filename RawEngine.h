@@ -0,0 +1,64 @@
+//
+//  RawEngine.h
+//  AlephOne
+//
+// This should remain a *pure* C library with no references to external libraries
+
+/*
+ * The oscillator kernel described by RawEngine.dsp, as plain C that runs anywhere.
+ *
+ * Per sample, in the terms of the .dsp:
+ *
+ *   cycles        = i*cyclesPerSample + phase
+ *   cycleLocation = frac(cycles)
+ *   hiD = loD + negone,  hiE = loE + negone
+ *   loExpress = w00*loD + w01*hiD
+ *   hiExpress = w10*loD + w11*hiD
+ *   expressed = loExpress*loE + hiExpress*hiE
+ *   unAliased = fundamental*hiPitch + expressed*loPitch
+ *
+ * The .dsp takes w00..w11 and fundamental as input vectors.  Here they are the corner waveforms
+ * of the expression square, evaluated at cycleLocation: w00 is a sine, w01 a triangle, w10 a saw
+ * and w11 a square, and fundamental is the sine.  loD and loE move the voice around that square,
+ * and as the pitch rises hiPitch fades the bright corners out in favour of the fundamental,
+ * which is how the kernel avoids aliasing.
+ *
+ * Expression and pitch are held for a block; the .dsp's debugging output z is not produced.
+ */
+
+/*
+ * Everything one voice needs from block to block.  phase is in cycles, in [0,1).
+ */
+struct RawEngine_voice
+{
+    float phase;
+    float cyclesPerSample;
+    float loD;
+    float loE;
+    float loPitch;
+    float hiPitch;
+};
+
+/*
+ * Silent voice at phase zero, in the w00 (sine) corner.
+ */
+void RawEngine_initVoice(struct RawEngine_voice* v);
+
+/*
+ * Set cyclesPerSample and the loPitch/hiPitch crossfade from a fractional MIDI note.
+ */
+void RawEngine_setPitch(struct RawEngine_voice* v, float pitch, float sampleRate);
+
+/*
+ * Render n samples of the voice into out and advance its phase.
+ * RawEngine_render works on several samples at a time; RawEngine_renderScalar is the
+ * straightforward one sample at a time reference that it is checked against.
+ */
+void RawEngine_render(struct RawEngine_voice* v, float* out, int n);
+void RawEngine_renderScalar(struct RawEngine_voice* v, float* out, int n);
+
+/*
+ * Render the same voices both ways over a spread of pitches and expression, and fail if the
+ * block renderer strays from the reference.  Returns the largest difference seen.
+ */
+float RawEngine_selfTest(int (*fail)(const char*,...), void (*passed)());
@@ -0,0 +1,89 @@
+//
+//  RawEngineKernel.h
+//  AlephOne
+//
+// The per sample math of RawEngine.dsp on a vector of lanes.  RawEngine runs it across the
+// samples of one voice, and VoiceBank runs it across voices, so it lives here where both can
+// inline it.
+
+#ifndef RAWENGINEKERNEL_H
+#define RAWENGINEKERNEL_H
+
+#include "EngineCommon.h"
+
+#define RAWENGINE_NEGONE -1.0f
+//Crossfade from the expressed waveform to the fundamental between these notes
+#define RAWENGINE_LOPITCH_NOTE 84.0f
+#define RAWENGINE_HIPITCH_NOTE 108.0f
+
+/**
+ The corner waveforms, for a cycle location x in [0,1).
+ The sine is the parabolic approximation with one refinement step (within 0.1% of full scale),
+ which keeps the kernel free of table lookups and libm.
+ */
+static inline Engine_vf RawEngine_sine(Engine_vf x)
+{
+    Engine_vf t = x*2 - 1;
+    Engine_vf at = Engine_max(t,-t);
+    Engine_vf y = 4*t*(1 - at);
+    Engine_vf ay = Engine_max(y,-y);
+    return -(0.225f*(y*ay - y) + y);
+}
+
+static inline Engine_vf RawEngine_triangle(Engine_vf x)
+{
+    Engine_vf d = x - 0.5f;
+    return 1 - 4*Engine_max(d,-d);
+}
+
+static inline Engine_vf RawEngine_saw(Engine_vf x)
+{
+    return x*2 - 1;
+}
+
+static inline Engine_vf RawEngine_square(Engine_vf x)
+{
+    return Engine_select(x < 0.5f,Engine_splat(1),Engine_splat(-1));
+}
+
+static inline Engine_vf RawEngine_frac(Engine_vf cycles)
+{
+    return cycles - __builtin_convertvector(Engine_floori(cycles),Engine_vf);
+}
+
+/**
+ unAliased for each lane, with the expression square already reduced to a weight per corner:
+ a00 = loD*loE, a01 = hiD*loE, a10 = loD*hiE and a11 = hiD*hiE, times any gain on that corner.
+ Expression that only changes per block costs nothing per sample this way.
+ */
+static inline Engine_vf RawEngine_kernelCorners(Engine_vf cycleLocation,Engine_vf a00,Engine_vf a01,Engine_vf a10,Engine_vf a11,Engine_vf loPitch,Engine_vf hiPitch)
+{
+    Engine_vf fundamental = RawEngine_sine(cycleLocation);
+    Engine_vf w00 = fundamental;
+    Engine_vf w01 = RawEngine_triangle(cycleLocation);
+    Engine_vf w10 = RawEngine_saw(cycleLocation);
+    Engine_vf w11 = RawEngine_square(cycleLocation);
+    Engine_vf expressed = w00*a00 + w01*a01 + w10*a10 + w11*a11;
+    return fundamental*hiPitch + expressed*loPitch;
+}
+
+/**
+ unAliased for each lane, given where it is in its cycle
+ */
+static inline Engine_vf RawEngine_kernel(Engine_vf cycleLocation,Engine_vf loD,Engine_vf loE,Engine_vf loPitch,Engine_vf hiPitch)
+{
+    Engine_vf hiD = loD + RAWENGINE_NEGONE;
+    Engine_vf hiE = loE + RAWENGINE_NEGONE;
+    return RawEngine_kernelCorners(cycleLocation,loD*loE,hiD*loE,loD*hiE,hiD*hiE,loPitch,hiPitch);
+}
+
+/**
+ hiPitch for each lane from its fractional MIDI note; loPitch is 1-hiPitch
+ */
+static inline Engine_vf RawEngine_hiPitch(Engine_vf pitch)
+{
+    Engine_vf hi = (pitch - RAWENGINE_LOPITCH_NOTE) * (1.0f/(RAWENGINE_HIPITCH_NOTE - RAWENGINE_LOPITCH_NOTE));
+    return Engine_min(Engine_max(hi,Engine_splat(0)),Engine_splat(1));
+}
+
+#endif
@@ -0,0 +1,396 @@
+//
+//  RenderPool.c
+//  AlephOne
+//
+/**
+    Each worker's share of a block is a range of its queue, packed with the block's epoch, top and
+    bottom into one word.  The owner takes from the bottom and thieves take from the top, both by
+    compare and swap on that word, so a bank can only ever be claimed once and nobody waits on
+    anybody.  A worker only takes from ranges of the epoch it woke up for, so one still finishing
+    off a block can't wander into the next, whose ranges the caller may be dealing out already.
+
+    The caller counts banks down to zero to know that the block is done.  Every worker writes its
+    mix before its last count, so once the count reaches zero all the mixes are complete.  A worker
+    owns its mix, starting it afresh at the first bank it renders for a new epoch, and the caller
+    only sums mixes whose epoch is the block's.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "RenderPool.h"
+#include "VoiceBank.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <time.h>
+#include "FretlessCommon.h"
+
+//How much of each new block's load goes into the smoothed load
+#define RENDERPOOL_LOAD_SMOOTHING 0.1f
+//Keep each worker's hot fields on their own cache lines
+#define RENDERPOOL_LINE 64
+
+struct RenderPool_worker
+{
+    char padding[RENDERPOOL_LINE];
+    struct RenderPool* pool;
+    int index;
+    pthread_t thread;
+    int started;
+    sem_t wake;
+    //Epoch in the high half, then top and bottom
+    unsigned long long range;
+    int queue[RENDERPOOL_BANKMAX];
+    //Written only by the worker: the last epoch it rendered for, and whether its mix has anything
+    //in it yet for that epoch
+    unsigned int epoch;
+    int mixed;
+    float* mixLeft;
+    float* mixRight;
+    float* bankLeft;
+    float* bankRight;
+    //Seconds spent rendering in the worker's epoch
+    double busy;
+    float load;
+    long steals;
+};
+
+struct RenderPool
+{
+    struct RenderPool_worker* workers[RENDERPOOL_THREADMAX];
+    int threadCount;
+    struct VoiceBank_context* banks[RENDERPOOL_BANKMAX];
+    int bankCount;
+    int maxBlock;
+    float sampleRate;
+    //The block being rendered
+    unsigned int epoch;
+    int n;
+    int stereo;
+    int remaining;
+    int quit;
+    void (*renderPoolFree)(void*);
+};
+
+static double RenderPool_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static unsigned long long RenderPool_pack(unsigned int epoch, unsigned int top, unsigned int bottom)
+{
+    return ((unsigned long long)epoch << 32) | (top << 16) | bottom;
+}
+
+//The owner's end
+static int RenderPool_pop(struct RenderPool_worker* w, unsigned int epoch)
+{
+    unsigned long long range = __atomic_load_n(&w->range,__ATOMIC_ACQUIRE);
+    while(TRUE)
+    {
+        unsigned int top = (range >> 16) & 0xFFFF;
+        unsigned int bottom = range & 0xFFFF;
+        if((range >> 32) != epoch || top >= bottom)
+        {
+            return -1;
+        }
+        if(__atomic_compare_exchange_n(&w->range,&range,RenderPool_pack(epoch,top,bottom-1),FALSE,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE))
+        {
+            return w->queue[bottom-1];
+        }
+    }
+}
+
+//The thieves' end
+static int RenderPool_steal(struct RenderPool_worker* w, unsigned int epoch)
+{
+    unsigned long long range = __atomic_load_n(&w->range,__ATOMIC_ACQUIRE);
+    while(TRUE)
+    {
+        unsigned int top = (range >> 16) & 0xFFFF;
+        unsigned int bottom = range & 0xFFFF;
+        if((range >> 32) != epoch || top >= bottom)
+        {
+            return -1;
+        }
+        if(__atomic_compare_exchange_n(&w->range,&range,RenderPool_pack(epoch,top+1,bottom),FALSE,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE))
+        {
+            return w->queue[top];
+        }
+    }
+}
+
+static int RenderPool_take(struct RenderPool* pool, struct RenderPool_worker* w, unsigned int epoch)
+{
+    int bank = RenderPool_pop(w,epoch);
+    for(int i=1; bank < 0 && i<pool->threadCount; i++)
+    {
+        bank = RenderPool_steal(pool->workers[(w->index + i) % pool->threadCount],epoch);
+        if(bank >= 0)
+        {
+            w->steals++;
+        }
+    }
+    return bank;
+}
+
+//Render banks of the epoch's block into this worker's mix until there are none left anywhere
+static void RenderPool_work(struct RenderPool* pool, struct RenderPool_worker* w, unsigned int epoch)
+{
+    int bank;
+    while((bank = RenderPool_take(pool,w,epoch)) >= 0)
+    {
+        if(w->epoch != epoch)
+        {
+            __atomic_store_n(&w->epoch,epoch,__ATOMIC_RELAXED);
+            w->mixed = FALSE;
+            w->busy = 0;
+        }
+        double started = RenderPool_now();
+        int n = pool->n;
+        float* right = pool->stereo ? w->bankRight : NULL;
+        if(!w->mixed)
+        {
+            VoiceBank_render(pool->banks[bank],w->mixLeft,pool->stereo ? w->mixRight : NULL,n);
+            w->mixed = TRUE;
+        }
+        else
+        {
+            VoiceBank_render(pool->banks[bank],w->bankLeft,right,n);
+            for(int s=0; s<n; s++)
+            {
+                w->mixLeft[s] += w->bankLeft[s];
+            }
+            if(right)
+            {
+                for(int s=0; s<n; s++)
+                {
+                    w->mixRight[s] += right[s];
+                }
+            }
+        }
+        w->busy += RenderPool_now() - started;
+        __atomic_sub_fetch(&pool->remaining,1,__ATOMIC_RELEASE);
+    }
+}
+
+static void* RenderPool_thread(void* arg)
+{
+    struct RenderPool_worker* w = arg;
+    struct RenderPool* pool = w->pool;
+    while(TRUE)
+    {
+        while(sem_wait(&w->wake) != 0)
+        {
+            //Interrupted by a signal
+        }
+        if(__atomic_load_n(&pool->quit,__ATOMIC_ACQUIRE))
+        {
+            return NULL;
+        }
+        RenderPool_work(pool,w,__atomic_load_n(&pool->epoch,__ATOMIC_ACQUIRE));
+    }
+}
+
+static int RenderPool_start(struct RenderPool_worker* w, int (*logger)(const char*,...))
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr,PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr,SCHED_FIFO);
+    struct sched_param param;
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+    pthread_attr_setschedparam(&attr,&param);
+    int started = (pthread_create(&w->thread,&attr,RenderPool_thread,w) == 0);
+    pthread_attr_destroy(&attr);
+    if(!started)
+    {
+        logger("RenderPool: no realtime scheduling for worker %d, running it at normal priority\n",w->index);
+        started = (pthread_create(&w->thread,NULL,RenderPool_thread,w) == 0);
+    }
+    if(!started)
+    {
+        logger("RenderPool: cannot start worker %d\n",w->index);
+    }
+    return started;
+}
+
+struct RenderPool* RenderPool_init(int threads, int maxBlock, float sampleRate,
+                                   int (*logger)(const char*,...),
+                                   void* (*renderPoolAlloc)(unsigned long),
+                                   void (*renderPoolFree)(void*))
+{
+    if(threads < 1)threads = 1;
+    if(threads > RENDERPOOL_THREADMAX)threads = RENDERPOOL_THREADMAX;
+    struct RenderPool* pool = renderPoolAlloc(sizeof(struct RenderPool));
+    pool->threadCount = threads;
+    pool->bankCount = 0;
+    pool->maxBlock = maxBlock;
+    pool->sampleRate = sampleRate;
+    pool->epoch = 0;
+    pool->n = 0;
+    pool->stereo = FALSE;
+    pool->remaining = 0;
+    pool->quit = FALSE;
+    pool->renderPoolFree = renderPoolFree;
+    for(int i=0; i<threads; i++)
+    {
+        struct RenderPool_worker* w = renderPoolAlloc(sizeof(struct RenderPool_worker));
+        w->pool = pool;
+        w->index = i;
+        w->started = FALSE;
+        w->range = 0;
+        w->epoch = 0;
+        w->mixed = FALSE;
+        w->mixLeft = renderPoolAlloc(maxBlock*sizeof(float));
+        w->mixRight = renderPoolAlloc(maxBlock*sizeof(float));
+        w->bankLeft = renderPoolAlloc(maxBlock*sizeof(float));
+        w->bankRight = renderPoolAlloc(maxBlock*sizeof(float));
+        w->busy = 0;
+        w->load = 0;
+        w->steals = 0;
+        sem_init(&w->wake,0,0);
+        pool->workers[i] = w;
+    }
+    //Worker 0 is whoever calls render
+    for(int i=1; i<threads; i++)
+    {
+        pool->workers[i]->started = RenderPool_start(pool->workers[i],logger);
+    }
+    return pool;
+}
+
+void RenderPool_free(struct RenderPool* pool)
+{
+    __atomic_store_n(&pool->quit,TRUE,__ATOMIC_RELEASE);
+    //Workers steal from each other, so all must have stopped before any is freed
+    for(int i=0; i<pool->threadCount; i++)
+    {
+        struct RenderPool_worker* w = pool->workers[i];
+        if(w->started)
+        {
+            sem_post(&w->wake);
+            pthread_join(w->thread,NULL);
+        }
+    }
+    for(int i=0; i<pool->threadCount; i++)
+    {
+        struct RenderPool_worker* w = pool->workers[i];
+        sem_destroy(&w->wake);
+        pool->renderPoolFree(w->mixLeft);
+        pool->renderPoolFree(w->mixRight);
+        pool->renderPoolFree(w->bankLeft);
+        pool->renderPoolFree(w->bankRight);
+        pool->renderPoolFree(w);
+    }
+    pool->renderPoolFree(pool);
+}
+
+int RenderPool_addBank(struct RenderPool* pool, struct VoiceBank_context* bank)
+{
+    if(pool->bankCount == RENDERPOOL_BANKMAX)
+    {
+        return FALSE;
+    }
+    pool->banks[pool->bankCount++] = bank;
+    return TRUE;
+}
+
+static void RenderPool_renderBlock(struct RenderPool* pool, float* left, float* right, int n)
+{
+    //Epoch 0 is never dealt, so no worker starts out looking as if it had rendered
+    unsigned int epoch = pool->epoch + 1;
+    if(epoch == 0)
+    {
+        epoch = 1;
+    }
+    __atomic_store_n(&pool->epoch,epoch,__ATOMIC_RELEASE);
+    pool->n = n;
+    pool->stereo = (right != NULL);
+    __atomic_store_n(&pool->remaining,pool->bankCount,__ATOMIC_RELAXED);
+    //Deal the banks out round robin
+    int dealt[RENDERPOOL_THREADMAX] = {0};
+    for(int b=0; b<pool->bankCount; b++)
+    {
+        struct RenderPool_worker* w = pool->workers[b % pool->threadCount];
+        w->queue[dealt[w->index]++] = b;
+    }
+    for(int i=0; i<pool->threadCount; i++)
+    {
+        __atomic_store_n(&pool->workers[i]->range,RenderPool_pack(epoch,0,dealt[i]),__ATOMIC_RELEASE);
+    }
+    for(int i=1; i<pool->threadCount; i++)
+    {
+        if(pool->workers[i]->started && dealt[i] > 0)
+        {
+            sem_post(&pool->workers[i]->wake);
+        }
+    }
+    RenderPool_work(pool,pool->workers[0],epoch);
+    //Anything still outstanding is being rendered right now by another worker
+    while(__atomic_load_n(&pool->remaining,__ATOMIC_ACQUIRE) > 0)
+    {
+        sched_yield();
+    }
+
+    for(int s=0; s<n; s++)
+    {
+        left[s] = 0;
+    }
+    if(right)
+    {
+        for(int s=0; s<n; s++)
+        {
+            right[s] = 0;
+        }
+    }
+    float period = n / pool->sampleRate;
+    for(int i=0; i<pool->threadCount; i++)
+    {
+        struct RenderPool_worker* w = pool->workers[i];
+        //Nobody can take a bank of the next block until it is dealt, so the worker's fields hold
+        //still while they are read
+        int current = (__atomic_load_n(&w->epoch,__ATOMIC_RELAXED) == epoch);
+        w->load += ((current ? w->busy : 0)/period - w->load) * RENDERPOOL_LOAD_SMOOTHING;
+        if(!current || !w->mixed)
+        {
+            continue;
+        }
+        for(int s=0; s<n; s++)
+        {
+            left[s] += w->mixLeft[s];
+        }
+        if(right)
+        {
+            for(int s=0; s<n; s++)
+            {
+                right[s] += w->mixRight[s];
+            }
+        }
+    }
+}
+
+void RenderPool_render(struct RenderPool* pool, float* left, float* right, int n)
+{
+    for(int done=0; done<n; done+=pool->maxBlock)
+    {
+        int length = (n - done < pool->maxBlock) ? n - done : pool->maxBlock;
+        RenderPool_renderBlock(pool,left+done,right ? right+done : NULL,length);
+    }
+}
+
+int RenderPool_getThreadCount(struct RenderPool* pool)
+{
+    return pool->threadCount;
+}
+
+float RenderPool_getLoad(struct RenderPool* pool, int worker)
+{
+    return pool->workers[worker]->load;
+}
+
+long RenderPool_getSteals(struct RenderPool* pool, int worker)
+{
+    return pool->workers[worker]->steals;
+}
@@ -0,0 +1,56 @@
+//
+//  RenderPool.h
+//  AlephOne
+//
+// Rendering several voice banks (one per Fretless player) in parallel.
+//
+// A fixed pool of worker threads is started up front.  Each block, the banks are dealt out to
+// the workers, and a worker that runs out steals from the others, so one slow bank doesn't hold
+// the block up while other cores sit idle.  The calling (audio) thread works too, as worker 0.
+// Every worker mixes what it renders into its own buffer, and the caller sums those at the end,
+// so no two threads ever write the same memory.
+//
+// RenderPool_render does no allocation and takes no locks: workers are woken with semaphores and
+// banks are claimed with compare and swap.  Like SMF, this uses the OS directly (pthreads).
+
+#define RENDERPOOL_THREADMAX 16
+#define RENDERPOOL_BANKMAX 16
+
+struct RenderPool;
+struct VoiceBank_context;
+
+/*
+ * Start threads-1 workers (the caller is the other one) for blocks of up to maxBlock samples.
+ * Workers ask for realtime (SCHED_FIFO) scheduling, and run at normal priority, after logging,
+ * when they can't have it.
+ */
+struct RenderPool* RenderPool_init(int threads, int maxBlock, float sampleRate,
+                                   int (*logger)(const char*,...),
+                                   void* (*renderPoolAlloc)(unsigned long),
+                                   void (*renderPoolFree)(void*));
+
+void RenderPool_free(struct RenderPool* pool);
+
+/*
+ * Add a bank to be rendered by the pool.  Not to be done while rendering.
+ * Returns FALSE if there are already RENDERPOOL_BANKMAX.
+ */
+int RenderPool_addBank(struct RenderPool* pool, struct VoiceBank_context* bank);
+
+/*
+ * Render every bank and sum them into left and right (NULL for mono), overwriting them.
+ */
+void RenderPool_render(struct RenderPool* pool, float* left, float* right, int n);
+
+int RenderPool_getThreadCount(struct RenderPool* pool);
+
+/*
+ * The fraction of each block's realtime that a worker spends rendering, smoothed over recent blocks.
+ * Worker 0 is the calling thread.
+ */
+float RenderPool_getLoad(struct RenderPool* pool, int worker);
+
+/*
+ * How many banks a worker has taken from other workers' shares.
+ */
+long RenderPool_getSteals(struct RenderPool* pool, int worker);
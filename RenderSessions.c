@@ -0,0 +1,80 @@
+//
+//  RenderSessions.c
+//  AlephOne
+//
+// Render MIDI sessions to WAV beside them, in parallel:
+//
+//   RenderSessions -j 8 -r 48000 take1.mid take2.mid ...
+//
+// writes take1.wav and so on.  Jobs default to one per core, the rate to 48000.
+// RenderSessions -t runs the bank's and the renderer's self tests instead.
+#define _POSIX_C_SOURCE 200809L
+
+#include "OfflineRender.h"
+#include "VoiceBank.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void RenderSessions_bankPassed()
+{
+    printf("VoiceBank_selfTest: passed\n");
+}
+
+static void RenderSessions_renderPassed()
+{
+    printf("OfflineRender_selfTest: passed\n");
+}
+
+int main(int argc, char** argv)
+{
+    if(argc == 2 && strcmp(argv[1],"-t") == 0)
+    {
+        int ok = VoiceBank_selfTest(malloc,free,printf,RenderSessions_bankPassed);
+        ok = OfflineRender_selfTest(printf,RenderSessions_renderPassed) && ok;
+        return ok ? 0 : 1;
+    }
+    int jobs = 0;
+    float sampleRate = 48000;
+    int first = 1;
+    while(first + 1 < argc && argv[first][0] == '-')
+    {
+        if(strcmp(argv[first],"-j") == 0)
+        {
+            jobs = atoi(argv[first+1]);
+        }
+        else if(strcmp(argv[first],"-r") == 0)
+        {
+            sampleRate = atof(argv[first+1]);
+        }
+        else
+        {
+            break;
+        }
+        first += 2;
+    }
+    if(first >= argc || sampleRate <= 0)
+    {
+        fprintf(stderr,"usage: %s [-j jobs] [-r sampleRate] file.mid... | -t\n",argv[0]);
+        return 1;
+    }
+    int count = argc - first;
+    const char** wavNames = malloc(count * sizeof(char*));
+    for(int i=0; i<count; i++)
+    {
+        const char* midiName = argv[first+i];
+        const char* dot = strrchr(midiName,'.');
+        size_t stem = (dot && !strchr(dot,'/')) ? (size_t)(dot - midiName) : strlen(midiName);
+        char* wavName = malloc(stem + sizeof(".wav"));
+        memcpy(wavName,midiName,stem);
+        strcpy(wavName+stem,".wav");
+        wavNames[i] = wavName;
+    }
+    int succeeded = OfflineRender_files((const char* const*)(argv+first),wavNames,count,jobs,sampleRate,printf);
+    for(int i=0; i<count; i++)
+    {
+        free((char*)wavNames[i]);
+    }
+    free(wavNames);
+    return (succeeded == count) ? 0 : 1;
+}
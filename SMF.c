@@ -0,0 +1,356 @@
+//
+//  SMF.c
+//  AlephOne
+//
+/**
+    Tracks are merged with a k-way min heap keyed on absolute tick, so only one cursor per track
+    is held at any time.  Tempo changes are applied as they come out of the merge, which keeps the
+    tick to sample conversion exact across the whole tempo map without building the map first.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "SMF.h"
+#include "DeMIDI.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "FretlessCommon.h"
+
+#define SMF_DEFAULT_TEMPO 500000
+#define SMF_META 0xFF
+#define SMF_META_TEMPO 0x51
+#define SMF_META_END 0x2F
+#define SMF_SYSEX 0xF0
+#define SMF_SYSEX_ESCAPE 0xF7
+
+/**
+ Where we are in one track.  tick is the absolute time of the event at pos.
+ */
+struct SMF_track
+{
+    const unsigned char* start;
+    const unsigned char* pos;
+    const unsigned char* end;
+    long tick;
+    int runningStatus;
+    int index;
+};
+
+struct SMF_file
+{
+    const unsigned char* map;
+    size_t mapLength;
+    int format;
+    int division;
+    int trackCount;
+    struct SMF_track* tracks;
+    //Heap of tracks that still have events, ordered by (tick,index)
+    struct SMF_track** heap;
+    int heapCount;
+    double eventsPerSecond;
+    int (*logger)(const char*,...);
+};
+
+static int SMF_read16(const unsigned char* p)
+{
+    return (p[0]<<8) | p[1];
+}
+
+static long SMF_read32(const unsigned char* p)
+{
+    return ((long)p[0]<<24) | (p[1]<<16) | (p[2]<<8) | p[3];
+}
+
+//Variable length quantity.  Returns FALSE if it runs off the end of the track.
+static int SMF_readVLQ(const unsigned char** pp,const unsigned char* end,long* val)
+{
+    long v = 0;
+    const unsigned char* p = *pp;
+    for(int i=0; i<4; i++)
+    {
+        if(p >= end)
+        {
+            return FALSE;
+        }
+        unsigned char c = *p++;
+        v = (v<<7) | (c & 0x7F);
+        if((c & 0x80) == 0)
+        {
+            *pp = p;
+            *val = v;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static int SMF_before(struct SMF_track* a,struct SMF_track* b)
+{
+    return (a->tick < b->tick) || (a->tick == b->tick && a->index < b->index);
+}
+
+static void SMF_siftDown(struct SMF_file* smf,int i)
+{
+    struct SMF_track** h = smf->heap;
+    int n = smf->heapCount;
+    while(TRUE)
+    {
+        int l = 2*i+1;
+        int r = l+1;
+        int m = i;
+        if(l < n && SMF_before(h[l],h[m]))m = l;
+        if(r < n && SMF_before(h[r],h[m]))m = r;
+        if(m == i)
+        {
+            return;
+        }
+        struct SMF_track* t = h[i];
+        h[i] = h[m];
+        h[m] = t;
+        i = m;
+    }
+}
+
+//Read the delta time in front of the next event.  FALSE when the track is done.
+static int SMF_advance(struct SMF_track* t)
+{
+    long delta;
+    if(t->pos >= t->end || !SMF_readVLQ(&t->pos,t->end,&delta))
+    {
+        return FALSE;
+    }
+    t->tick += delta;
+    return TRUE;
+}
+
+struct SMF_file* SMF_open(const char* fname, int (*logger)(const char*,...))
+{
+    int fd = open(fname,O_RDONLY);
+    if(fd < 0)
+    {
+        logger("SMF_open: cannot open %s\n",fname);
+        return NULL;
+    }
+    struct stat st;
+    if(fstat(fd,&st) != 0 || st.st_size < 14)
+    {
+        logger("SMF_open: %s is too short to be a MIDI file\n",fname);
+        close(fd);
+        return NULL;
+    }
+    void* map = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        logger("SMF_open: cannot map %s\n",fname);
+        return NULL;
+    }
+    //Each track is read front to back, so let the kernel read ahead and drop behind us
+    posix_madvise(map,st.st_size,POSIX_MADV_SEQUENTIAL);
+
+    const unsigned char* p = map;
+    const unsigned char* end = p + st.st_size;
+    if(memcmp(p,"MThd",4) != 0 || SMF_read32(p+4) < 6)
+    {
+        logger("SMF_open: %s has no MThd header\n",fname);
+        munmap(map,st.st_size);
+        return NULL;
+    }
+    struct SMF_file* smf = calloc(1,sizeof(struct SMF_file));
+    smf->map = map;
+    smf->mapLength = st.st_size;
+    smf->logger = logger;
+    smf->format = SMF_read16(p+8);
+    int declaredTracks = SMF_read16(p+10);
+    smf->division = SMF_read16(p+12);
+    smf->tracks = calloc(declaredTracks,sizeof(struct SMF_track));
+    smf->heap = calloc(declaredTracks,sizeof(struct SMF_track*));
+    if(smf->format == 2)
+    {
+        logger("SMF_open: %s is format 2, tracks will be merged as if simultaneous\n",fname);
+    }
+
+    //Walk the chunks, skipping any that are not tracks
+    p += 8 + SMF_read32(p+4);
+    while(p + 8 <= end && smf->trackCount < declaredTracks)
+    {
+        long length = SMF_read32(p+4);
+        const unsigned char* body = p + 8;
+        if(length < 0 || body + length > end)
+        {
+            logger("SMF_open: chunk runs past end of %s, truncating\n",fname);
+            length = end - body;
+        }
+        if(memcmp(p,"MTrk",4) == 0)
+        {
+            struct SMF_track* t = &smf->tracks[smf->trackCount];
+            t->start = body;
+            t->end = body + length;
+            t->index = smf->trackCount;
+            smf->trackCount++;
+        }
+        p = body + length;
+    }
+    if(smf->trackCount != declaredTracks)
+    {
+        logger("SMF_open: header says %d tracks, found %d\n",declaredTracks,smf->trackCount);
+    }
+    return smf;
+}
+
+void SMF_close(struct SMF_file* smf)
+{
+    munmap((void*)smf->map,smf->mapLength);
+    free(smf->tracks);
+    free(smf->heap);
+    free(smf);
+}
+
+int SMF_getTrackCount(struct SMF_file* smf)
+{
+    return smf->trackCount;
+}
+
+double SMF_getEventsPerSecond(struct SMF_file* smf)
+{
+    return smf->eventsPerSecond;
+}
+
+static double SMF_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+long SMF_play(struct SMF_file* smf, double sampleRate,
+              void (*event)(double sampleTime,int status,const unsigned char* data,int length))
+{
+    double started = SMF_now();
+    long count = 0;
+
+    //Tempo map state: everything before lastTick has been converted to samples already
+    long lastTick = 0;
+    double lastSample = 0;
+    double samplesPerTick;
+    int isSMPTE = (smf->division & 0x8000) != 0;
+    if(isSMPTE)
+    {
+        int fps = -(signed char)(smf->division >> 8);
+        int ticksPerFrame = smf->division & 0xFF;
+        double frameRate = (fps == 29) ? 29.97 : fps;
+        samplesPerTick = sampleRate / (frameRate * ticksPerFrame);
+    }
+    else
+    {
+        samplesPerTick = SMF_DEFAULT_TEMPO * 1e-6 * sampleRate / smf->division;
+    }
+
+    smf->heapCount = 0;
+    for(int i=0; i<smf->trackCount; i++)
+    {
+        struct SMF_track* t = &smf->tracks[i];
+        t->pos = t->start;
+        t->tick = 0;
+        t->runningStatus = 0;
+        if(SMF_advance(t))
+        {
+            smf->heap[smf->heapCount++] = t;
+        }
+    }
+    for(int i=smf->heapCount/2-1; i>=0; i--)
+    {
+        SMF_siftDown(smf,i);
+    }
+
+    while(smf->heapCount > 0)
+    {
+        struct SMF_track* t = smf->heap[0];
+        const unsigned char* p = t->pos;
+        const unsigned char* end = t->end;
+        double sampleTime = lastSample + (t->tick - lastTick)*samplesPerTick;
+        int ok = (p < end);
+        if(ok)
+        {
+            int status = *p;
+            if(status == SMF_META)
+            {
+                long length = 0;
+                ok = (p+2 <= end);
+                int type = ok ? p[1] : 0;
+                p += 2;
+                ok = ok && SMF_readVLQ(&p,end,&length) && (p + length <= end);
+                if(ok && type == SMF_META_TEMPO && length == 3 && !isSMPTE)
+                {
+                    long usPerQuarter = (p[0]<<16) | (p[1]<<8) | p[2];
+                    lastSample = sampleTime;
+                    lastTick = t->tick;
+                    samplesPerTick = usPerQuarter * 1e-6 * sampleRate / smf->division;
+                }
+                if(ok && type == SMF_META_END)
+                {
+                    ok = FALSE;
+                }
+                p += length;
+            }
+            else
+            if(status == SMF_SYSEX || status == SMF_SYSEX_ESCAPE)
+            {
+                long length = 0;
+                p++;
+                ok = SMF_readVLQ(&p,end,&length) && (p + length <= end);
+                p += length;
+            }
+            else
+            {
+                if(status & 0x80)
+                {
+                    t->runningStatus = status;
+                    p++;
+                }
+                else
+                {
+                    status = t->runningStatus;
+                }
+                int length = ((status & 0xE0) == 0xC0) ? 1 : 2;
+                ok = (status & 0x80) && (p + length <= end);
+                if(ok)
+                {
+                    event(sampleTime,status,p,length);
+                    count++;
+                }
+                p += length;
+            }
+        }
+        t->pos = p;
+        //Replace the top of the heap with this track's next event, or drop the track
+        if(!ok || !SMF_advance(t))
+        {
+            smf->heap[0] = smf->heap[--smf->heapCount];
+        }
+        SMF_siftDown(smf,0);
+    }
+
+    double elapsed = SMF_now() - started;
+    smf->eventsPerSecond = (elapsed > 0) ? count / elapsed : 0;
+    smf->logger("SMF_play: %ld events in %f seconds, %f events/sec\n",count,elapsed,smf->eventsPerSecond);
+    return count;
+}
+
+void SMF_putDeMIDI(double sampleTime,int status,const unsigned char* data,int length)
+{
+    if(!DeMIDI_parses(status))
+    {
+        return;
+    }
+    DeMIDI_setTime(sampleTime);
+    DeMIDI_putch((char)status);
+    for(int i=0; i<length; i++)
+    {
+        DeMIDI_putch((char)data[i]);
+    }
+}
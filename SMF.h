@@ -0,0 +1,41 @@
+//
+//  SMF.h
+//  AlephOne
+//
+// Standard MIDI File reader for offline rendering.
+//
+// Unlike Fretless and DeMIDI, this is a host side utility and uses the OS directly
+// (mmap, clock_gettime).  The file is mapped read-only and walked in place, so memory
+// use doesn't grow with the size of the file, only with the number of tracks.
+
+struct SMF_file;
+
+/*
+ * Map a .mid file and check its header and track chunks.
+ * Returns NULL (after logging why) if it can't be read as an SMF.
+ */
+struct SMF_file* SMF_open(const char* fname, int (*logger)(const char*,...));
+
+void SMF_close(struct SMF_file* smf);
+
+int SMF_getTrackCount(struct SMF_file* smf);
+
+/*
+ * Merge all tracks by absolute tick and hand every channel message to event,
+ * in order, with its time in samples from the tempo map.  data points into the mapped file,
+ * and does not include the status byte (which may have come from running status).
+ *
+ * Returns the number of channel messages delivered.
+ */
+long SMF_play(struct SMF_file* smf, double sampleRate,
+              void (*event)(double sampleTime,int status,const unsigned char* data,int length));
+
+/*
+ * A ready made event callback for SMF_play that timestamps and puts messages into DeMIDI.
+ */
+void SMF_putDeMIDI(double sampleTime,int status,const unsigned char* data,int length);
+
+/*
+ * Throughput of the last SMF_play, in channel messages per second of wall clock time.
+ */
+double SMF_getEventsPerSecond(struct SMF_file* smf);
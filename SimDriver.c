@@ -0,0 +1,343 @@
+//
+//  SimDriver.c
+//  AlephOne
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include "SimDriver.h"
+#include "SMF.h"
+#include "DeMIDI.h"
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "FretlessCommon.h"
+
+//Channel messages only, which is all DeMIDI parses
+#define SIMDRIVER_MESSAGEMAX 3
+#define SIMDRIVER_INITIAL_EVENTS 1024
+
+struct SimDriver_event
+{
+    double sampleTime;
+    int length;
+    unsigned char bytes[SIMDRIVER_MESSAGEMAX];
+};
+
+struct SimDriver_context
+{
+    float sampleRate;
+    int blockSize;
+    int realtime;
+    void (*callback)(void* user,float* left,float* right,int n);
+    void* user;
+    float* left;
+    float* right;
+    //Queued input, in time order, and the next one to deliver
+    struct SimDriver_event* events;
+    long eventCount;
+    long eventCapacity;
+    long nextEvent;
+    //Sample number of the start of the next block, carried across runs
+    double time;
+    //What the last run asked for
+    long blocksToRun;
+    long blocks;
+    long misses;
+    long histogram[SIMDRIVER_BUCKETS];
+    double worst;
+    //How late the thread woke for its period, at worst, in seconds
+    double worstWake;
+    void* (*simDriverAlloc)(unsigned long);
+    void (*simDriverFree)(void*);
+};
+
+//SMF_play has no user pointer, so the driver being filled is held here
+static struct SimDriver_context* collecting = NULL;
+
+static double SimDriver_toSeconds(struct timespec* ts)
+{
+    return ts->tv_sec + ts->tv_nsec*1e-9;
+}
+
+static double SimDriver_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return SimDriver_toSeconds(&ts);
+}
+
+static void SimDriver_sleepUntil(double seconds)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+    while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,NULL) != 0)
+    {
+        //Interrupted by a signal
+    }
+}
+
+struct SimDriver_context* SimDriver_init(float sampleRate, int blockSize,
+                                         void (*callback)(void* user,float* left,float* right,int n),
+                                         void* user,
+                                         void* (*simDriverAlloc)(unsigned long),
+                                         void (*simDriverFree)(void*))
+{
+    struct SimDriver_context* ctxp = simDriverAlloc(sizeof(struct SimDriver_context));
+    ctxp->sampleRate = sampleRate;
+    ctxp->blockSize = blockSize;
+    ctxp->realtime = TRUE;
+    ctxp->callback = callback;
+    ctxp->user = user;
+    ctxp->left = simDriverAlloc(blockSize*sizeof(float));
+    ctxp->right = simDriverAlloc(blockSize*sizeof(float));
+    ctxp->eventCapacity = SIMDRIVER_INITIAL_EVENTS;
+    ctxp->events = simDriverAlloc(ctxp->eventCapacity*sizeof(struct SimDriver_event));
+    ctxp->eventCount = 0;
+    ctxp->nextEvent = 0;
+    ctxp->time = 0;
+    ctxp->blocksToRun = 0;
+    ctxp->blocks = 0;
+    ctxp->misses = 0;
+    ctxp->worst = 0;
+    ctxp->worstWake = 0;
+    for(int b=0; b<SIMDRIVER_BUCKETS; b++)
+    {
+        ctxp->histogram[b] = 0;
+    }
+    ctxp->simDriverAlloc = simDriverAlloc;
+    ctxp->simDriverFree = simDriverFree;
+    return ctxp;
+}
+
+void SimDriver_free(struct SimDriver_context* ctxp)
+{
+    ctxp->simDriverFree(ctxp->left);
+    ctxp->simDriverFree(ctxp->right);
+    ctxp->simDriverFree(ctxp->events);
+    ctxp->simDriverFree(ctxp);
+}
+
+void SimDriver_setRealtime(struct SimDriver_context* ctxp, int realtime)
+{
+    ctxp->realtime = realtime;
+}
+
+void SimDriver_addMessage(struct SimDriver_context* ctxp, double sampleTime, const unsigned char* bytes, int length)
+{
+    if(length < 1 || length > SIMDRIVER_MESSAGEMAX)
+    {
+        return;
+    }
+    if(ctxp->eventCount == ctxp->eventCapacity)
+    {
+        struct SimDriver_event* grown = ctxp->simDriverAlloc(2*ctxp->eventCapacity*sizeof(struct SimDriver_event));
+        __builtin_memcpy(grown,ctxp->events,ctxp->eventCount*sizeof(struct SimDriver_event));
+        ctxp->simDriverFree(ctxp->events);
+        ctxp->events = grown;
+        ctxp->eventCapacity *= 2;
+    }
+    //Nearly always appends; anything out of order is walked back into place
+    long i = ctxp->eventCount;
+    while(i > 0 && ctxp->events[i-1].sampleTime > sampleTime)
+    {
+        ctxp->events[i] = ctxp->events[i-1];
+        i--;
+    }
+    struct SimDriver_event* e = &ctxp->events[i];
+    e->sampleTime = sampleTime;
+    e->length = length;
+    for(int b=0; b<length; b++)
+    {
+        e->bytes[b] = bytes[b];
+    }
+    ctxp->eventCount++;
+}
+
+static void SimDriver_collect(double sampleTime,int status,const unsigned char* data,int length)
+{
+    if(!DeMIDI_parses(status))
+    {
+        return;
+    }
+    unsigned char bytes[SIMDRIVER_MESSAGEMAX];
+    bytes[0] = status;
+    for(int i=0; i<length && i+1<SIMDRIVER_MESSAGEMAX; i++)
+    {
+        bytes[i+1] = data[i];
+    }
+    SimDriver_addMessage(collecting,sampleTime,bytes,(length+1 < SIMDRIVER_MESSAGEMAX) ? length+1 : SIMDRIVER_MESSAGEMAX);
+}
+
+long SimDriver_addSMF(struct SimDriver_context* ctxp, struct SMF_file* smf)
+{
+    long before = ctxp->eventCount;
+    collecting = ctxp;
+    SMF_play(smf,ctxp->sampleRate,SimDriver_collect);
+    collecting = NULL;
+    return ctxp->eventCount - before;
+}
+
+//Put this block's input into DeMIDI, stamped with its sample
+static void SimDriver_deliver(struct SimDriver_context* ctxp, double blockEnd)
+{
+    while(ctxp->nextEvent < ctxp->eventCount && ctxp->events[ctxp->nextEvent].sampleTime < blockEnd)
+    {
+        struct SimDriver_event* e = &ctxp->events[ctxp->nextEvent++];
+        DeMIDI_setTime(e->sampleTime);
+        for(int b=0; b<e->length; b++)
+        {
+            DeMIDI_putch((char)e->bytes[b]);
+        }
+    }
+}
+
+static void SimDriver_record(struct SimDriver_context* ctxp, double fraction)
+{
+    int bucket = (int)(fraction * 100);
+    if(bucket >= SIMDRIVER_BUCKETS)
+    {
+        bucket = SIMDRIVER_BUCKETS - 1;
+    }
+    ctxp->histogram[bucket]++;
+    ctxp->worst = (fraction > ctxp->worst) ? fraction : ctxp->worst;
+}
+
+static void* SimDriver_thread(void* arg)
+{
+    struct SimDriver_context* ctxp = arg;
+    int n = ctxp->blockSize;
+    double period = n / ctxp->sampleRate;
+    double periodStart = SimDriver_now();
+    for(long b=0; b<ctxp->blocksToRun; b++)
+    {
+        if(ctxp->realtime)
+        {
+            SimDriver_sleepUntil(periodStart);
+        }
+        double started = SimDriver_now();
+        if(ctxp->realtime && started - periodStart > ctxp->worstWake)
+        {
+            ctxp->worstWake = started - periodStart;
+        }
+        SimDriver_deliver(ctxp,ctxp->time + n);
+        ctxp->callback(ctxp->user,ctxp->left,ctxp->right,n);
+        ctxp->time += n;
+        double finished = SimDriver_now();
+        SimDriver_record(ctxp,(finished - started) / period);
+        ctxp->blocks++;
+        if(ctxp->realtime)
+        {
+            //The buffer was due when the next period started; a late one is an xrun, and the
+            //hardware carries on from wherever it has got to
+            periodStart += period;
+            if(finished > periodStart)
+            {
+                ctxp->misses++;
+                while(periodStart < finished)
+                {
+                    periodStart += period;
+                }
+            }
+        }
+        else if(finished - started > period)
+        {
+            ctxp->misses++;
+        }
+    }
+    return NULL;
+}
+
+long SimDriver_run(struct SimDriver_context* ctxp, double seconds, int (*logger)(const char*,...))
+{
+    ctxp->blocksToRun = (long)(seconds * ctxp->sampleRate / ctxp->blockSize);
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr,PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr,SCHED_FIFO);
+    struct sched_param param;
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+    pthread_attr_setschedparam(&attr,&param);
+    long before = ctxp->blocks;
+    int started = (pthread_create(&thread,&attr,SimDriver_thread,ctxp) == 0);
+    pthread_attr_destroy(&attr);
+    if(!started)
+    {
+        logger("SimDriver: no realtime scheduling, running the audio thread at normal priority\n");
+        started = (pthread_create(&thread,NULL,SimDriver_thread,ctxp) == 0);
+    }
+    if(!started)
+    {
+        logger("SimDriver: cannot start the audio thread\n");
+        return -1;
+    }
+    pthread_join(thread,NULL);
+    return ctxp->blocks - before;
+}
+
+long SimDriver_getBlocks(struct SimDriver_context* ctxp)
+{
+    return ctxp->blocks;
+}
+
+long SimDriver_getDeadlineMisses(struct SimDriver_context* ctxp)
+{
+    return ctxp->misses;
+}
+
+long SimDriver_getHistogram(struct SimDriver_context* ctxp, int bucket)
+{
+    return ctxp->histogram[bucket];
+}
+
+double SimDriver_getPercentile(struct SimDriver_context* ctxp, double p)
+{
+    long want = (long)(p * ctxp->blocks);
+    long seen = 0;
+    for(int b=0; b<SIMDRIVER_BUCKETS; b++)
+    {
+        seen += ctxp->histogram[b];
+        if(seen > want)
+        {
+            return (b + 1) / 100.0;
+        }
+    }
+    return ctxp->worst;
+}
+
+double SimDriver_getWorst(struct SimDriver_context* ctxp)
+{
+    return ctxp->worst;
+}
+
+double SimDriver_getWorstWakeup(struct SimDriver_context* ctxp)
+{
+    return ctxp->worstWake;
+}
+
+void SimDriver_report(struct SimDriver_context* ctxp, int (*logger)(const char*,...))
+{
+    logger("SimDriver, %d sample blocks at %.0f Hz, %s: %ld blocks, %ld missed deadlines\n",
+           ctxp->blockSize,ctxp->sampleRate,ctxp->realtime ? "realtime" : "faster than realtime",ctxp->blocks,ctxp->misses);
+    logger("  callback as %% of period: median under %.0f, 99%% under %.0f, 99.9%% under %.0f, worst %.1f\n",
+           SimDriver_getPercentile(ctxp,0.5)*100,SimDriver_getPercentile(ctxp,0.99)*100,
+           SimDriver_getPercentile(ctxp,0.999)*100,ctxp->worst*100);
+    if(ctxp->realtime)
+    {
+        logger("  worst wakeup latency %.1f us\n",ctxp->worstWake*1e6);
+    }
+    //The occupied part of the histogram, 10% to a row
+    for(int row=0; row<SIMDRIVER_BUCKETS; row+=10)
+    {
+        long count = 0;
+        for(int b=row; b<row+10 && b<SIMDRIVER_BUCKETS; b++)
+        {
+            count += ctxp->histogram[b];
+        }
+        if(count > 0)
+        {
+            logger("  %3d-%3d%%: %ld\n",row,row+10,count);
+        }
+    }
+}
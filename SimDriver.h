@@ -0,0 +1,79 @@
+//
+//  SimDriver.h
+//  AlephOne
+//
+// A stand-in audio driver, for testing deadline behavior on machines without audio hardware.
+//
+// It calls the engine's block callback from its own thread, asking for SCHED_FIFO as a real
+// audio thread would have, either at exact period intervals (realtime) or back to back (faster
+// than realtime).  Before each callback, the MIDI that falls in that block is put into DeMIDI
+// stamped with its sample, so the engine sees input the way it would from DeJitter.  Every
+// callback is timed, building a distribution of durations as a fraction of the period, and a
+// callback that finishes after its period is over is counted as a missed deadline.
+//
+// Like SMF, this uses the OS directly (pthreads, clock_nanosleep).
+
+//Durations are counted in buckets of 1% of the period, up to this many periods
+#define SIMDRIVER_HISTOGRAM_PERIODS 4
+#define SIMDRIVER_BUCKETS (100*SIMDRIVER_HISTOGRAM_PERIODS + 1)
+
+struct SimDriver_context;
+struct SMF_file;
+
+struct SimDriver_context* SimDriver_init(float sampleRate, int blockSize,
+                                         void (*callback)(void* user,float* left,float* right,int n),
+                                         void* user,
+                                         void* (*simDriverAlloc)(unsigned long),
+                                         void (*simDriverFree)(void*));
+
+void SimDriver_free(struct SimDriver_context* ctxp);
+
+/*
+ * TRUE (the default) waits for each period to start, as hardware would; FALSE runs blocks back
+ * to back, still judging each against the period.
+ */
+void SimDriver_setRealtime(struct SimDriver_context* ctxp, int realtime);
+
+/*
+ * Queue a MIDI message (status and data bytes) for the block containing sampleTime.
+ * Messages should be added in time order; gesture recordings replayed through Fretless can be
+ * added as Fretless produces them.
+ */
+void SimDriver_addMessage(struct SimDriver_context* ctxp, double sampleTime, const unsigned char* bytes, int length);
+
+/*
+ * Queue every message of a MIDI file that DeMIDI understands.  Returns how many were queued.
+ */
+long SimDriver_addSMF(struct SimDriver_context* ctxp, struct SMF_file* smf);
+
+/*
+ * Run for seconds of audio on the driver thread, returning when it is done.
+ * Returns the number of blocks, or -1 if the thread couldn't be started.
+ */
+long SimDriver_run(struct SimDriver_context* ctxp, double seconds, int (*logger)(const char*,...));
+
+long SimDriver_getBlocks(struct SimDriver_context* ctxp);
+long SimDriver_getDeadlineMisses(struct SimDriver_context* ctxp);
+
+/*
+ * Callbacks whose duration fell in [bucket, bucket+1) percent of the period.  The last bucket
+ * holds everything longer.
+ */
+long SimDriver_getHistogram(struct SimDriver_context* ctxp, int bucket);
+
+/*
+ * The callback duration, as a fraction of the period, that fraction p of callbacks came in under.
+ */
+double SimDriver_getPercentile(struct SimDriver_context* ctxp, double p);
+double SimDriver_getWorst(struct SimDriver_context* ctxp);
+
+/*
+ * In realtime mode, the longest the thread took to wake after its period started, in seconds.
+ * Misses can come from this scheduling latency as well as from slow callbacks.
+ */
+double SimDriver_getWorstWakeup(struct SimDriver_context* ctxp);
+
+/*
+ * Log the duration distribution and misses.
+ */
+void SimDriver_report(struct SimDriver_context* ctxp, int (*logger)(const char*,...));
@@ -0,0 +1,906 @@
+//
+//  VoiceBank.c
+//  AlephOne
+//
+// This should remain a *pure* C library with no references to external libraries
+
+/**
+    Lanes are voices.  The outer loop walks the sounding voices, packed ENGINE_LANES at a time, keeping their state in
+    registers, and the inner loop walks the samples of the block, accumulating each group's
+    output into one vector per sample.  Only at the end is each sample's vector summed across
+    its lanes into the mix bus, so the expensive per voice work never leaves the vector unit.
+ */
+
+#include "VoiceBank.h"
+#include "RawEngineKernel.h"
+#include "EngineMath.h"
+#include "DeMIDI.h"
+#include "Wavetable.h"
+#include "Oversample.h"
+#include "EngineParams.h"
+#include <math.h>
+
+//Longer renders are done in pieces of this size
+#define VOICEBANK_BLOCKMAX 512
+#define VOICEBANK_DEFAULT_GAIN 0.25f
+//Which controllers move the voice around the expression square
+#define VOICEBANK_CC_D 1
+#define VOICEBANK_CC_E 11
+#define VOICEBANK_EVENTMAX 256
+//A change of oversampling plays the old factor alone while the new filters fill, then crossfades
+#define VOICEBANK_FADE_PRIME 32
+#define VOICEBANK_FADE 64
+//The self test crowds more updates than the queue holds onto these samples
+#define VOICEBANK_TEST_RATE 48000
+#define VOICEBANK_TEST_SAMPLE 1000.5
+#define VOICEBANK_TEST_BURST 300
+
+/**
+ An update waiting for its sample
+ */
+struct VoiceBank_event
+{
+    double sampleTime;
+    int voice;
+    int doNoteAttack;
+    float pitch;
+    float volVal;
+    int midiExprParm;
+    int midiExpr;
+};
+
+struct VoiceBank_context
+{
+    //Per voice state, VOICEMAX wide, walked ENGINE_LANES at a time
+    float phase[VOICEMAX] __attribute__((aligned(16)));
+    float increment[VOICEMAX] __attribute__((aligned(16)));
+    float incrementStart[VOICEMAX] __attribute__((aligned(16)));
+    //Where pitch and volume were at the start of the block, and where updates have taken them since
+    float pitchStart[VOICEMAX] __attribute__((aligned(16)));
+    float pitch[VOICEMAX] __attribute__((aligned(16)));
+    float volumeStart[VOICEMAX] __attribute__((aligned(16)));
+    float volume[VOICEMAX] __attribute__((aligned(16)));
+    float loD[VOICEMAX] __attribute__((aligned(16)));
+    float loE[VOICEMAX] __attribute__((aligned(16)));
+    float panLeft[VOICEMAX] __attribute__((aligned(16)));
+    float panRight[VOICEMAX] __attribute__((aligned(16)));
+    int tied[VOICEMAX];
+    //Bit v is set from the attack that makes voice v sound until its release has ramped to silence
+    unsigned int active;
+    //Voices silenced to keep within voiceCap, which stay silent until their note ends
+    unsigned int culled;
+    int voiceCap;
+    float sampleRate;
+    float gain;
+    int ramp;
+    //Sample number of the next sample to be rendered
+    double time;
+    //Pending updates, in time order
+    struct VoiceBank_event events[VOICEBANK_EVENTMAX];
+    int eventCount;
+    //Each sample's sum over one group of voices, before summing across lanes
+    Engine_vf busLeft[VOICEBANK_BLOCKMAX];
+    Engine_vf busRight[VOICEBANK_BLOCKMAX];
+    //When set, voices read band-limited tables instead of running the RawEngine kernel
+    struct Wavetable_bank* wavetable;
+    float voiceOut[VOICEBANK_BLOCKMAX];
+    //The kernel's mix at oversampling times the output rate, and the filters that bring it back down
+    int oversampling;
+    float overLeft[VOICEBANK_BLOCKMAX];
+    float overRight[VOICEBANK_BLOCKMAX];
+    //The factor being rendered, through decimate[decimating]; while fadeFrom is set, the factor before it
+    //keeps running through the other pair and the output is fadeAt samples into the crossfade between them
+    int factor;
+    int fadeFrom;
+    int fadeAt;
+    int decimating;
+    struct Oversample_decimator* decimate[2][2];
+    float fadeLeft[VOICEBANK_BLOCKMAX];
+    float fadeRight[VOICEBANK_BLOCKMAX];
+    //Patch parameters from the UI, and where they are at the start and end of the stretch being rendered
+    struct EngineParams_context* params;
+    float paramStart[ENGINEPARAMS_COUNT];
+    float paramEnd[ENGINEPARAMS_COUNT];
+    void (*voiceBankFree)(void*);
+};
+
+static struct VoiceBank_context* listening = NULL;
+
+struct VoiceBank_context* VoiceBank_init(float sampleRate,
+                                         void* (*voiceBankAlloc)(unsigned long),
+                                         void (*voiceBankFree)(void*))
+{
+    struct VoiceBank_context* ctxp = voiceBankAlloc(sizeof(struct VoiceBank_context));
+    ctxp->sampleRate = sampleRate;
+    ctxp->gain = VOICEBANK_DEFAULT_GAIN;
+    ctxp->ramp = VOICEBANK_RAMP_EXPONENTIAL;
+    ctxp->time = 0;
+    ctxp->eventCount = 0;
+    ctxp->wavetable = NULL;
+    ctxp->active = 0;
+    ctxp->culled = 0;
+    ctxp->voiceCap = VOICEMAX;
+    ctxp->oversampling = 1;
+    ctxp->factor = 1;
+    ctxp->fadeFrom = 0;
+    ctxp->fadeAt = 0;
+    ctxp->decimating = 0;
+    for(int pair=0; pair<2; pair++)
+    {
+        ctxp->decimate[pair][0] = Oversample_init(voiceBankAlloc,voiceBankFree);
+        ctxp->decimate[pair][1] = Oversample_init(voiceBankAlloc,voiceBankFree);
+    }
+    VoiceBank_setParams(ctxp,NULL);
+    ctxp->voiceBankFree = voiceBankFree;
+    for(int v=0; v<VOICEMAX; v++)
+    {
+        ctxp->phase[v] = 0;
+        ctxp->increment[v] = 0;
+        ctxp->incrementStart[v] = 0;
+        ctxp->pitchStart[v] = 0;
+        ctxp->pitch[v] = 0;
+        ctxp->volumeStart[v] = 0;
+        ctxp->volume[v] = 0;
+        ctxp->loD[v] = 1;
+        ctxp->loE[v] = 1;
+        ctxp->tied[v] = FALSE;
+        VoiceBank_setPan(ctxp,v,0);
+    }
+    return ctxp;
+}
+
+void VoiceBank_free(struct VoiceBank_context* ctxp)
+{
+    if(listening == ctxp)
+    {
+        listening = NULL;
+    }
+    for(int pair=0; pair<2; pair++)
+    {
+        Oversample_free(ctxp->decimate[pair][0]);
+        Oversample_free(ctxp->decimate[pair][1]);
+    }
+    ctxp->voiceBankFree(ctxp);
+}
+
+void VoiceBank_listen(struct VoiceBank_context* ctxp)
+{
+    listening = ctxp;
+}
+
+void VoiceBank_rawEngine(int midiChannel,int doNoteAttack,float pitch,float volVal,int midiExprParm,int midiExpr)
+{
+    if(listening)
+    {
+        VoiceBank_schedule(listening,DeMIDI_getTime(),midiChannel,doNoteAttack,pitch,volVal,midiExprParm,midiExpr);
+    }
+}
+
+void VoiceBank_setTime(struct VoiceBank_context* ctxp,double sampleTime)
+{
+    ctxp->time = sampleTime;
+}
+
+double VoiceBank_getTime(struct VoiceBank_context* ctxp)
+{
+    return ctxp->time;
+}
+
+static int VoiceBank_isTie(struct VoiceBank_event* e)
+{
+    return e->doNoteAttack && e->pitch == 0 && e->volVal == 0;
+}
+
+/**
+ Whether applying just u does what applying e then u on the same sample would: neither is a tie,
+ the voice is sounding after both or after neither, and no expression controller is lost.
+ */
+static int VoiceBank_mergeable(struct VoiceBank_event* e,struct VoiceBank_event* u)
+{
+    int exprKept = (e->midiExprParm == u->midiExprParm) ||
+                   (e->midiExprParm != VOICEBANK_CC_D && e->midiExprParm != VOICEBANK_CC_E);
+    return e->voice == u->voice && (long)e->sampleTime == (long)u->sampleTime &&
+           !VoiceBank_isTie(e) && !VoiceBank_isTie(u) && (e->volVal > 0) == (u->volVal > 0) && exprKept;
+}
+
+/**
+ Fold every pending update that can be into the one before it for its voice, the later pitch and
+ volume winning, to make room in the queue without moving anything off its sample.
+ */
+static void VoiceBank_compact(struct VoiceBank_context* ctxp)
+{
+    int last[VOICEMAX];
+    for(int v=0; v<VOICEMAX; v++)
+    {
+        last[v] = -1;
+    }
+    int kept = 0;
+    for(int i=0; i<ctxp->eventCount; i++)
+    {
+        struct VoiceBank_event* u = &ctxp->events[i];
+        int v = u->voice;
+        if(v >= 0 && v < VOICEMAX && last[v] >= 0 && VoiceBank_mergeable(&ctxp->events[last[v]],u))
+        {
+            //Keeping the earlier time, on the same sample, keeps the queue in order
+            double sampleTime = ctxp->events[last[v]].sampleTime;
+            ctxp->events[last[v]] = *u;
+            ctxp->events[last[v]].sampleTime = sampleTime;
+            continue;
+        }
+        ctxp->events[kept] = *u;
+        if(v >= 0 && v < VOICEMAX)
+        {
+            last[v] = kept;
+        }
+        kept++;
+    }
+    ctxp->eventCount = kept;
+}
+
+/**
+ Make room by applying, in order, everything pending up to sampleTime.  Those updates lose their
+ place within the block, but nothing scheduled later can overtake them.
+ */
+static void VoiceBank_applyUntil(struct VoiceBank_context* ctxp,double sampleTime)
+{
+    int used = 0;
+    while(used < ctxp->eventCount && ctxp->events[used].sampleTime <= sampleTime)
+    {
+        struct VoiceBank_event* e = &ctxp->events[used];
+        VoiceBank_update(ctxp,e->voice,e->doNoteAttack,e->pitch,e->volVal,e->midiExprParm,e->midiExpr);
+        used++;
+    }
+    ctxp->eventCount -= used;
+    for(int i=0; i<ctxp->eventCount; i++)
+    {
+        ctxp->events[i] = ctxp->events[i+used];
+    }
+}
+
+void VoiceBank_schedule(struct VoiceBank_context* ctxp,double sampleTime,int voice,int doNoteAttack,float pitch,float volVal,int midiExprParm,int midiExpr)
+{
+    //Anything that is already due happens at the start of the next render
+    if(sampleTime <= ctxp->time)
+    {
+        VoiceBank_update(ctxp,voice,doNoteAttack,pitch,volVal,midiExprParm,midiExpr);
+        return;
+    }
+    if(ctxp->eventCount == VOICEBANK_EVENTMAX)
+    {
+        VoiceBank_compact(ctxp);
+    }
+    if(ctxp->eventCount == VOICEBANK_EVENTMAX)
+    {
+        VoiceBank_applyUntil(ctxp,sampleTime);
+        if(ctxp->eventCount == VOICEBANK_EVENTMAX)
+        {
+            //Everything pending comes after this one, so it can go first
+            VoiceBank_update(ctxp,voice,doNoteAttack,pitch,volVal,midiExprParm,midiExpr);
+            return;
+        }
+    }
+    //Insert in time order, after anything at the same time so that ties stay ahead of their notes
+    int i = ctxp->eventCount;
+    while(i > 0 && ctxp->events[i-1].sampleTime > sampleTime)
+    {
+        ctxp->events[i] = ctxp->events[i-1];
+        i--;
+    }
+    struct VoiceBank_event* e = &ctxp->events[i];
+    e->sampleTime = sampleTime;
+    e->voice = voice;
+    e->doNoteAttack = doNoteAttack;
+    e->pitch = pitch;
+    e->volVal = volVal;
+    e->midiExprParm = midiExprParm;
+    e->midiExpr = midiExpr;
+    ctxp->eventCount++;
+}
+
+void VoiceBank_update(struct VoiceBank_context* ctxp,int voice,int doNoteAttack,float pitch,float volVal,int midiExprParm,int midiExpr)
+{
+    if(voice < 0 || voice >= VOICEMAX)
+    {
+        return;
+    }
+    if(doNoteAttack && pitch == 0 && volVal == 0)
+    {
+        ctxp->tied[voice] = TRUE;
+        return;
+    }
+    if(ctxp->culled & (1u << voice))
+    {
+        if(volVal == 0)
+        {
+            ctxp->culled &= ~(1u << voice);
+        }
+        volVal = 0;
+    }
+    //A new attack restarts the waveform unless it was tied to the note before it,
+    //and starts right on its pitch rather than gliding from wherever the voice last was
+    if(volVal > 0 && ctxp->volume[voice] == 0)
+    {
+        if(!ctxp->tied[voice])
+        {
+            ctxp->phase[voice] = 0;
+            ctxp->pitchStart[voice] = pitch;
+        }
+        ctxp->tied[voice] = FALSE;
+    }
+    ctxp->pitch[voice] = pitch;
+    ctxp->volume[voice] = volVal;
+    if(volVal > 0)
+    {
+        ctxp->active |= 1u << voice;
+    }
+    if(midiExprParm == VOICEBANK_CC_D)
+    {
+        ctxp->loD[voice] = midiExpr / 127.0f;
+    }
+    if(midiExprParm == VOICEBANK_CC_E)
+    {
+        ctxp->loE[voice] = midiExpr / 127.0f;
+    }
+}
+
+void VoiceBank_setPan(struct VoiceBank_context* ctxp,int voice,float pan)
+{
+    //Equal power
+    float angle = (pan + 1) * 0.25f * 3.14159265f;
+    ctxp->panLeft[voice] = cosf(angle);
+    ctxp->panRight[voice] = sinf(angle);
+}
+
+void VoiceBank_setGain(struct VoiceBank_context* ctxp,float gain)
+{
+    ctxp->gain = gain;
+}
+
+void VoiceBank_setRamp(struct VoiceBank_context* ctxp,int ramp)
+{
+    ctxp->ramp = ramp;
+}
+
+unsigned int VoiceBank_getActive(struct VoiceBank_context* ctxp)
+{
+    return ctxp->active;
+}
+
+void VoiceBank_setVoiceCap(struct VoiceBank_context* ctxp,int cap)
+{
+    ctxp->voiceCap = (cap < 0) ? 0 : cap;
+}
+
+int VoiceBank_getVoiceCap(struct VoiceBank_context* ctxp)
+{
+    return ctxp->voiceCap;
+}
+
+unsigned int VoiceBank_getCulled(struct VoiceBank_context* ctxp)
+{
+    return ctxp->culled;
+}
+
+/**
+ Release the quietest voices until no more than voiceCap are still held.  They ramp out over the
+ next block like any other release, so culling doesn't click.
+ */
+static void VoiceBank_cull(struct VoiceBank_context* ctxp)
+{
+    int held = 0;
+    for(int v=0; v<VOICEMAX; v++)
+    {
+        held += (ctxp->volume[v] > 0);
+    }
+    while(held > ctxp->voiceCap)
+    {
+        int quietest = -1;
+        for(int v=0; v<VOICEMAX; v++)
+        {
+            if(ctxp->volume[v] > 0 && (quietest < 0 || ctxp->volume[v] < ctxp->volume[quietest]))
+            {
+                quietest = v;
+            }
+        }
+        ctxp->volume[quietest] = 0;
+        ctxp->culled |= 1u << quietest;
+        held--;
+    }
+}
+
+void VoiceBank_setOversampling(struct VoiceBank_context* ctxp,int factor)
+{
+    if(factor != 1 && factor != 2 && factor != 4)
+    {
+        return;
+    }
+    //Takes effect, with a crossfade, from the next stretch rendered
+    ctxp->oversampling = factor;
+}
+
+int VoiceBank_getOversampling(struct VoiceBank_context* ctxp)
+{
+    return ctxp->oversampling;
+}
+
+void VoiceBank_setWavetable(struct VoiceBank_context* ctxp,struct Wavetable_bank* wavetable)
+{
+    ctxp->wavetable = wavetable;
+}
+
+struct Wavetable_bank* VoiceBank_getWavetable(struct VoiceBank_context* ctxp)
+{
+    return ctxp->wavetable;
+}
+
+void VoiceBank_setParams(struct VoiceBank_context* ctxp,struct EngineParams_context* params)
+{
+    ctxp->params = params;
+    if(!params)
+    {
+        struct EngineParams_set defaults;
+        EngineParams_defaults(&defaults);
+        __builtin_memcpy(ctxp->paramStart,defaults.value,sizeof(ctxp->paramStart));
+        __builtin_memcpy(ctxp->paramEnd,defaults.value,sizeof(ctxp->paramEnd));
+    }
+}
+
+struct EngineParams_context* VoiceBank_getParams(struct VoiceBank_context* ctxp)
+{
+    return ctxp->params;
+}
+
+static float VoiceBank_sumLanes(Engine_vf x)
+{
+    float sum = 0;
+    for(int l=0; l<ENGINE_LANES; l++)
+    {
+        sum += x[l];
+    }
+    return sum;
+}
+
+/**
+ 2^x for one ratio, exact at 0 so that an untuned bank or an unbent voice keeps its pitch
+ */
+static float VoiceBank_exp2(float x)
+{
+    return EngineMath_exp2Ratio(Engine_splat(x))[0];
+}
+
+/**
+ The same glide, one voice at a time through the wavetables, which pick their mip levels per voice.
+ Increments come from VoiceBank_renderBlock, already converted.
+ */
+static void VoiceBank_renderWavetable(struct VoiceBank_context* ctxp,float* left,float* right,int n)
+{
+    int stereo = (right != NULL);
+    float perSample = 1.0f / n;
+    float tuneStart = ctxp->paramStart[ENGINEPARAMS_TUNE];
+    float tuneEnd = ctxp->paramEnd[ENGINEPARAMS_TUNE];
+    float gainStart = ctxp->gain * ctxp->paramStart[ENGINEPARAMS_GAIN];
+    float gainEnd = ctxp->gain * ctxp->paramEnd[ENGINEPARAMS_GAIN];
+    for(int s=0; s<n; s++)
+    {
+        left[s] = 0;
+    }
+    if(stereo)
+    {
+        for(int s=0; s<n; s++)
+        {
+            right[s] = 0;
+        }
+    }
+    for(int v=0; v<VOICEMAX; v++)
+    {
+        if(!(ctxp->active & (1u << v)))
+        {
+            continue;
+        }
+        struct Wavetable_voice w;
+        w.phase = ctxp->phase[v];
+        w.increment = ctxp->incrementStart[v];
+        w.ratio = 1;
+        w.step = 0;
+        if(ctxp->ramp == VOICEBANK_RAMP_EXPONENTIAL)
+        {
+            w.ratio = VoiceBank_exp2((ctxp->pitch[v] + tuneEnd - ctxp->pitchStart[v] - tuneStart) * (perSample/12));
+        }
+        else
+        {
+            w.step = (ctxp->increment[v] - w.increment) * perSample;
+        }
+        w.level = ctxp->volumeStart[v] * gainStart;
+        w.levelStep = (ctxp->volume[v] * gainEnd - w.level) * perSample;
+        //Band-limit for the highest pitch reached in the stretch
+        float pitchStart = ctxp->pitchStart[v] + tuneStart;
+        float pitchEnd = ctxp->pitch[v] + tuneEnd;
+        w.pitch = (pitchEnd > pitchStart) ? pitchEnd : pitchStart;
+        w.loD = ctxp->loD[v];
+        w.loE = ctxp->loE[v];
+        for(int c=0; c<WAVETABLE_CORNERS; c++)
+        {
+            w.cornerGain[c] = ctxp->paramEnd[ENGINEPARAMS_W00 + c];
+        }
+        for(int s=0; s<n; s++)
+        {
+            ctxp->voiceOut[s] = 0;
+        }
+        Wavetable_render(ctxp->wavetable,&w,ctxp->voiceOut,n);
+        ctxp->phase[v] = w.phase;
+        float panLeft = stereo ? ctxp->panLeft[v] : 1;
+        for(int s=0; s<n; s++)
+        {
+            left[s] += ctxp->voiceOut[s]*panLeft;
+        }
+        if(stereo)
+        {
+            for(int s=0; s<n; s++)
+            {
+                right[s] += ctxp->voiceOut[s]*ctxp->panRight[v];
+            }
+        }
+    }
+}
+
+//Lane l holds voice voices[l], and lanes past count are silent
+static Engine_vf VoiceBank_gather(const float* x,const int* voices,int count)
+{
+    Engine_vf lanes = Engine_splat(0);
+    for(int l=0; l<count && l<ENGINE_LANES; l++)
+    {
+        lanes[l] = x[voices[l]];
+    }
+    return lanes;
+}
+
+/**
+ The RawEngine kernel, ENGINE_LANES voices at a time.  The ramps are carried as per lane increments
+ (and a ratio, for exponential pitch), so stepped, linear and exponential all run the same branch free loop.
+
+ Only active voices are rendered, packed densely into lanes, so the cost follows the number of
+ sounding notes: two notes take one pass over the block, not one per group they happen to be in.
+ */
+static void VoiceBank_renderKernel(struct VoiceBank_context* ctxp,float* left,float* right,int n)
+{
+    int stereo = (right != NULL);
+    float perSample = 1.0f / n;
+    float tuneStart = ctxp->paramStart[ENGINEPARAMS_TUNE];
+    float tuneEnd = ctxp->paramEnd[ENGINEPARAMS_TUNE];
+    float gainStart = ctxp->gain * ctxp->paramStart[ENGINEPARAMS_GAIN];
+    float gainEnd = ctxp->gain * ctxp->paramEnd[ENGINEPARAMS_GAIN];
+    const float* cornerStart = &ctxp->paramStart[ENGINEPARAMS_W00];
+    const float* cornerEnd = &ctxp->paramEnd[ENGINEPARAMS_W00];
+    for(int s=0; s<n; s++)
+    {
+        ctxp->busLeft[s] = Engine_splat(0);
+        ctxp->busRight[s] = Engine_splat(0);
+    }
+    int voices[VOICEMAX];
+    int count = 0;
+    for(int v=0; v<VOICEMAX; v++)
+    {
+        if(ctxp->active & (1u << v))
+        {
+            voices[count++] = v;
+        }
+    }
+    for(int g=0; g<count; g+=ENGINE_LANES)
+    {
+        const int* v = &voices[g];
+        int lanes = count - g;
+        Engine_vf phase = VoiceBank_gather(ctxp->phase,v,lanes);
+        Engine_vf increment = VoiceBank_gather(ctxp->incrementStart,v,lanes);
+        Engine_vf pitchStart = VoiceBank_gather(ctxp->pitchStart,v,lanes) + tuneStart;
+        Engine_vf pitchEnd = VoiceBank_gather(ctxp->pitch,v,lanes) + tuneEnd;
+        Engine_vf ratio = Engine_splat(1);
+        Engine_vf step = Engine_splat(0);
+        if(ctxp->ramp == VOICEBANK_RAMP_EXPONENTIAL)
+        {
+            ratio = EngineMath_exp2Ratio((pitchEnd - pitchStart) * (perSample/12));
+        }
+        else
+        {
+            step = (VoiceBank_gather(ctxp->increment,v,lanes) - increment) * perSample;
+        }
+        //Expression is held for the stretch, and reduced to one weight per corner that ramps with the corner gains
+        Engine_vf loD = VoiceBank_gather(ctxp->loD,v,lanes);
+        Engine_vf loE = VoiceBank_gather(ctxp->loE,v,lanes);
+        Engine_vf hiD = loD + RAWENGINE_NEGONE;
+        Engine_vf hiE = loE + RAWENGINE_NEGONE;
+        Engine_vf square[WAVETABLE_CORNERS] = {loD*loE, hiD*loE, loD*hiE, hiD*hiE};
+        Engine_vf a[WAVETABLE_CORNERS];
+        Engine_vf aStep[WAVETABLE_CORNERS];
+        for(int c=0; c<WAVETABLE_CORNERS; c++)
+        {
+            a[c] = square[c] * cornerStart[c];
+            aStep[c] = square[c] * ((cornerEnd[c] - cornerStart[c]) * perSample);
+        }
+        Engine_vf hiPitch = RawEngine_hiPitch(pitchStart);
+        Engine_vf hiPitchStep = (RawEngine_hiPitch(pitchEnd) - hiPitch) * perSample;
+        Engine_vf level = VoiceBank_gather(ctxp->volumeStart,v,lanes) * gainStart;
+        Engine_vf levelStep = (VoiceBank_gather(ctxp->volume,v,lanes) * gainEnd - level) * perSample;
+        Engine_vf panLeft = stereo ? VoiceBank_gather(ctxp->panLeft,v,lanes) : Engine_splat(1);
+        Engine_vf panRight = VoiceBank_gather(ctxp->panRight,v,lanes);
+        for(int s=0; s<n; s++)
+        {
+            Engine_vf x = RawEngine_kernelCorners(phase,a[0],a[1],a[2],a[3],1 - hiPitch,hiPitch) * level;
+            ctxp->busLeft[s] += x*panLeft;
+            if(stereo)
+            {
+                ctxp->busRight[s] += x*panRight;
+            }
+            phase = RawEngine_frac(phase + increment);
+            increment = increment*ratio + step;
+            hiPitch += hiPitchStep;
+            level += levelStep;
+            a[0] += aStep[0];
+            a[1] += aStep[1];
+            a[2] += aStep[2];
+            a[3] += aStep[3];
+        }
+        for(int l=0; l<lanes && l<ENGINE_LANES; l++)
+        {
+            ctxp->phase[v[l]] = phase[l];
+        }
+    }
+    for(int s=0; s<n; s++)
+    {
+        left[s] = VoiceBank_sumLanes(ctxp->busLeft[s]);
+    }
+    if(stereo)
+    {
+        for(int s=0; s<n; s++)
+        {
+            right[s] = VoiceBank_sumLanes(ctxp->busRight[s]);
+        }
+    }
+}
+
+//All voices' pitches become phase increments together, tuning being a change of rate
+static void VoiceBank_increments(struct VoiceBank_context* ctxp,int factor)
+{
+    float rate = ctxp->sampleRate*factor;
+    EngineMath_pitchToIncrement(ctxp->pitchStart,ctxp->incrementStart,rate*VoiceBank_exp2(-ctxp->paramStart[ENGINEPARAMS_TUNE]/12));
+    EngineMath_pitchToIncrement(ctxp->pitch,ctxp->increment,rate*VoiceBank_exp2(-ctxp->paramEnd[ENGINEPARAMS_TUNE]/12));
+}
+
+//Run the kernel at factor times the output rate and filter it down through the decimators given
+static void VoiceBank_renderOversampled(struct VoiceBank_context* ctxp,int factor,struct Oversample_decimator** decimate,
+                                        float* left,float* right,int n)
+{
+    VoiceBank_increments(ctxp,factor);
+    if(factor == 1)
+    {
+        VoiceBank_renderKernel(ctxp,left,right,n);
+        return;
+    }
+    //The whole mix bus is decimated, not each voice, so the filter costs the same however many are sounding
+    VoiceBank_renderKernel(ctxp,ctxp->overLeft,right ? ctxp->overRight : NULL,n*factor);
+    Oversample_decimate(decimate[0],factor,ctxp->overLeft,left,n);
+    if(right)
+    {
+        Oversample_decimate(decimate[1],factor,ctxp->overRight,right,n);
+    }
+}
+
+/**
+ Render a stretch of n samples, gliding every voice from where it was at the start to where
+ the updates have since put it.
+ */
+static void VoiceBank_renderBlock(struct VoiceBank_context* ctxp,float* left,float* right,int n)
+{
+    if(ctxp->voiceCap < VOICEMAX)
+    {
+        VoiceBank_cull(ctxp);
+    }
+    if(ctxp->ramp == VOICEBANK_RAMP_STEP)
+    {
+        __builtin_memcpy(ctxp->pitchStart,ctxp->pitch,sizeof(ctxp->pitch));
+        __builtin_memcpy(ctxp->volumeStart,ctxp->volume,sizeof(ctxp->volume));
+    }
+    //Patch parameters glide across the stretch along with the voices
+    if(ctxp->params)
+    {
+        EngineParams_advance(ctxp->params,n,ctxp->paramStart,ctxp->paramEnd);
+    }
+    //The wavetables are already band-limited; only the kernel is oversampled
+    if(ctxp->wavetable)
+    {
+        VoiceBank_increments(ctxp,1);
+        VoiceBank_renderWavetable(ctxp,left,right,n);
+    }
+    else
+    {
+        //Resetting the filters mid-note would drop the output to silence and back, so a new factor
+        //starts on the spare pair of filters while the old one plays on, and takes over once they are full
+        if(ctxp->fadeFrom == 0 && ctxp->factor != ctxp->oversampling)
+        {
+            ctxp->fadeFrom = ctxp->factor;
+            ctxp->fadeAt = 0;
+            ctxp->factor = ctxp->oversampling;
+            ctxp->decimating ^= 1;
+            Oversample_reset(ctxp->decimate[ctxp->decimating][0]);
+            Oversample_reset(ctxp->decimate[ctxp->decimating][1]);
+        }
+        if(ctxp->fadeFrom)
+        {
+            //Both factors render the same stretch from the same phases
+            float phase[VOICEMAX];
+            __builtin_memcpy(phase,ctxp->phase,sizeof(phase));
+            VoiceBank_renderOversampled(ctxp,ctxp->fadeFrom,ctxp->decimate[ctxp->decimating ^ 1],ctxp->fadeLeft,right ? ctxp->fadeRight : NULL,n);
+            __builtin_memcpy(ctxp->phase,phase,sizeof(phase));
+            VoiceBank_renderOversampled(ctxp,ctxp->factor,ctxp->decimate[ctxp->decimating],left,right,n);
+            for(int s=0; s<n; s++)
+            {
+                int at = ctxp->fadeAt + s - VOICEBANK_FADE_PRIME;
+                float mix = (at <= 0) ? 0 : (at >= VOICEBANK_FADE) ? 1 : (float)at / VOICEBANK_FADE;
+                left[s] = ctxp->fadeLeft[s] + (left[s] - ctxp->fadeLeft[s])*mix;
+                if(right)
+                {
+                    right[s] = ctxp->fadeRight[s] + (right[s] - ctxp->fadeRight[s])*mix;
+                }
+            }
+            ctxp->fadeAt += n;
+            if(ctxp->fadeAt >= VOICEBANK_FADE_PRIME + VOICEBANK_FADE)
+            {
+                ctxp->fadeFrom = 0;
+            }
+        }
+        else
+        {
+            VoiceBank_renderOversampled(ctxp,ctxp->factor,ctxp->decimate[ctxp->decimating],left,right,n);
+        }
+    }
+    __builtin_memcpy(ctxp->pitchStart,ctxp->pitch,sizeof(ctxp->pitch));
+    __builtin_memcpy(ctxp->volumeStart,ctxp->volume,sizeof(ctxp->volume));
+    //Voices that were released have now ramped down to silence, and can be culled
+    for(int v=0; v<VOICEMAX; v++)
+    {
+        if(ctxp->volume[v] == 0)
+        {
+            ctxp->active &= ~(1u << v);
+        }
+    }
+}
+
+//Stretches longer than VOICEBANK_BLOCKMAX (at the oversampled rate) finish their ramps in the first piece
+static void VoiceBank_renderSegment(struct VoiceBank_context* ctxp,float* left,float* right,int n)
+{
+    //A crossfade runs the factor being left as well as the new one, and another change may be waiting behind it
+    int widest = ctxp->oversampling > ctxp->factor ? ctxp->oversampling : ctxp->factor;
+    widest = ctxp->fadeFrom > widest ? ctxp->fadeFrom : widest;
+    int most = VOICEBANK_BLOCKMAX / (ctxp->wavetable ? 1 : widest);
+    for(int done=0; done<n; done+=most)
+    {
+        int length = (n - done < most) ? n - done : most;
+        VoiceBank_renderBlock(ctxp,left+done,right ? right+done : NULL,length);
+    }
+}
+
+/**
+ Split the block at each pending update that falls inside it, so that attacks and ties take
+ effect on exactly their sample.  With nothing pending this is one uninterrupted pass.
+ */
+void VoiceBank_render(struct VoiceBank_context* ctxp,float* left,float* right,int n)
+{
+    if(ctxp->params)
+    {
+        EngineParams_acquire(ctxp->params);
+    }
+    int done = 0;
+    int used = 0;
+    while(used < ctxp->eventCount)
+    {
+        struct VoiceBank_event* e = &ctxp->events[used];
+        int offset = (int)(e->sampleTime - ctxp->time);
+        if(offset >= n)
+        {
+            break;
+        }
+        if(offset > done)
+        {
+            VoiceBank_renderSegment(ctxp,left+done,right ? right+done : NULL,offset-done);
+            done = offset;
+        }
+        VoiceBank_update(ctxp,e->voice,e->doNoteAttack,e->pitch,e->volVal,e->midiExprParm,e->midiExpr);
+        used++;
+    }
+    if(done < n)
+    {
+        VoiceBank_renderSegment(ctxp,left+done,right ? right+done : NULL,n-done);
+    }
+    if(used > 0)
+    {
+        ctxp->eventCount -= used;
+        for(int i=0; i<ctxp->eventCount; i++)
+        {
+            ctxp->events[i] = ctxp->events[i+used];
+        }
+    }
+    ctxp->time += n;
+}
+
+/**
+ Render up to sample end, returning the loudest sample on the way
+ */
+static float VoiceBank_testUntil(struct VoiceBank_context* ctxp,float* left,float* right,long end)
+{
+    float loudest = 0;
+    while(ctxp->time < end)
+    {
+        long remaining = end - (long)ctxp->time;
+        int n = (remaining < VOICEBANK_BLOCKMAX) ? (int)remaining : VOICEBANK_BLOCKMAX;
+        VoiceBank_render(ctxp,left,right,n);
+        for(int s=0; s<n; s++)
+        {
+            float a = (left[s] < 0) ? -left[s] : left[s];
+            loudest = (a > loudest) ? a : loudest;
+        }
+    }
+    return loudest;
+}
+
+int VoiceBank_selfTest(void* (*alloc)(unsigned long), void (*release)(void*),
+                       int (*fail)(const char*,...), void (*passed)())
+{
+    float left[VOICEBANK_BLOCKMAX];
+    float right[VOICEBANK_BLOCKMAX];
+    int ok = TRUE;
+    long due = (long)VOICEBANK_TEST_SAMPLE;
+    long after = due + VOICEBANK_TEST_RATE / 2;
+    for(int merging=0; merging<2; merging++)
+    {
+        //A note, a burst of bends (which fold together) or of retriggers (which don't), and the
+        //release, all on one sample: the note must not sound early, and must not be left stuck
+        struct VoiceBank_context* ctxp = VoiceBank_init(VOICEBANK_TEST_RATE,alloc,release);
+        VoiceBank_schedule(ctxp,VOICEBANK_TEST_SAMPLE,0,1,60,0.8f,0,0);
+        for(int i=0; i<VOICEBANK_TEST_BURST; i++)
+        {
+            float volVal = (merging || (i & 1)) ? 0.8f : 0;
+            VoiceBank_schedule(ctxp,VOICEBANK_TEST_SAMPLE,0,0,60 + 0.01f*i,volVal,0,0);
+        }
+        VoiceBank_schedule(ctxp,VOICEBANK_TEST_SAMPLE,0,0,60,0,0,0);
+        float early = VoiceBank_testUntil(ctxp,left,right,due);
+        VoiceBank_testUntil(ctxp,left,right,after);
+        if(merging && early > 0)
+        {
+            fail("VoiceBank_selfTest: %d bends on one sample moved the note ahead of it\n",VOICEBANK_TEST_BURST);
+            ok = FALSE;
+        }
+        if(VoiceBank_getActive(ctxp) != 0)
+        {
+            fail("VoiceBank_selfTest: a release after %d %s on its sample left the note stuck\n",
+                 VOICEBANK_TEST_BURST,merging ? "bends" : "retriggers");
+            ok = FALSE;
+        }
+        VoiceBank_free(ctxp);
+    }
+    //Every voice attacked and bent on one sample, more updates than the queue holds, must wait for it
+    struct VoiceBank_context* ctxp = VoiceBank_init(VOICEBANK_TEST_RATE,alloc,release);
+    for(int v=0; v<VOICEMAX; v++)
+    {
+        VoiceBank_schedule(ctxp,VOICEBANK_TEST_SAMPLE,v,1,48 + v,0.5f,0,0);
+    }
+    for(int i=0; i<VOICEBANK_TEST_BURST/VOICEMAX + 1; i++)
+    {
+        for(int v=0; v<VOICEMAX; v++)
+        {
+            VoiceBank_schedule(ctxp,VOICEBANK_TEST_SAMPLE,v,0,48 + v + 0.01f*i,0.5f,0,0);
+        }
+    }
+    float early = VoiceBank_testUntil(ctxp,left,right,due);
+    float late = VoiceBank_testUntil(ctxp,left,right,due + VOICEBANK_BLOCKMAX);
+    unsigned int all = (VOICEMAX < 32) ? (1u << VOICEMAX) - 1 : ~0u;
+    if(early > 0 || late == 0 || VoiceBank_getActive(ctxp) != all)
+    {
+        fail("VoiceBank_selfTest: %d voices crowded onto one sample did not all start on it\n",VOICEMAX);
+        ok = FALSE;
+    }
+    VoiceBank_free(ctxp);
+    if(ok)
+    {
+        passed();
+    }
+    return ok;
+}
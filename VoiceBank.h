@@ -0,0 +1,130 @@
+//
+//  VoiceBank.h
+//  AlephOne
+//
+// This should remain a *pure* C library with no references to external libraries
+
+/*
+ * The sound engine behind DeMIDI: one RawEngine oscillator per MIDI channel.
+ *
+ * Voice state is kept as structure-of-arrays (phase, increment, volume, expression, ...) so that
+ * the oscillators of ENGINE_LANES voices are computed together in vector lanes, and one pass over
+ * a block renders every channel.  Voices are summed to a mono or stereo mix bus.
+ *
+ * Updates and rendering are expected to happen on the same (audio) thread, for instance by
+ * releasing DeJitter into DeMIDI at the top of each block.
+ */
+struct VoiceBank_context;
+struct Wavetable_bank;
+struct EngineParams_context;
+
+struct VoiceBank_context* VoiceBank_init(float sampleRate,
+                                         void* (*voiceBankAlloc)(unsigned long),
+                                         void (*voiceBankFree)(void*));
+
+void VoiceBank_free(struct VoiceBank_context* ctxp);
+
+/*
+ * Pass VoiceBank_rawEngine to DeMIDI_start, and it will drive whichever bank last called listen.
+ * Updates are scheduled at DeMIDI_getTime(), so timestamped input (DeJitter, SMF) lands on its sample.
+ */
+void VoiceBank_listen(struct VoiceBank_context* ctxp);
+void VoiceBank_rawEngine(int midiChannel,int doNoteAttack,float pitch,float volVal,int midiExprParm,int midiExpr);
+
+/*
+ * The same update, for a bank that isn't the one DeMIDI is driving.
+ * doNoteAttack with zero pitch and volume is DeMIDI's note tie: the next attack on the voice
+ * continues its phase (legato) instead of restarting it.
+ */
+void VoiceBank_update(struct VoiceBank_context* ctxp,int voice,int doNoteAttack,float pitch,float volVal,int midiExprParm,int midiExpr);
+
+/*
+ * The bank's sample clock: the sample number of the next sample that render will produce.
+ * It starts at zero and advances by n with each render.
+ */
+void VoiceBank_setTime(struct VoiceBank_context* ctxp,double sampleTime);
+double VoiceBank_getTime(struct VoiceBank_context* ctxp);
+
+/*
+ * An update that takes effect at sampleTime on the bank's clock.  Render splits its block there, so
+ * attacks and ties happen on exactly that sample.  Updates that are already due apply at the start
+ * of the next render, as VoiceBank_update does.
+ * Updates are always applied in the order they were scheduled.  If more are pending than the bank
+ * can hold, updates are folded into the one before them for their voice on the same sample, where
+ * that changes nothing but the voice's pitch glide within the sample.  Only when none can be are
+ * the oldest pending updates applied early to make room.
+ */
+void VoiceBank_schedule(struct VoiceBank_context* ctxp,double sampleTime,int voice,int doNoteAttack,float pitch,float volVal,int midiExprParm,int midiExpr);
+
+/*
+ * -1 is hard left, 1 is hard right.  Voices start in the center.
+ */
+void VoiceBank_setPan(struct VoiceBank_context* ctxp,int voice,float pan);
+
+void VoiceBank_setGain(struct VoiceBank_context* ctxp,float gain);
+
+/*
+ * Updates don't step at the block boundary; each voice ramps from its old pitch and volume to the
+ * new ones across the next block (or up to the next scheduled update within it), so bends don't
+ * zipper even with large blocks.  Volume ramps
+ * linearly.  Pitch ramps linearly in frequency, or exponentially (linearly in semitones, the
+ * default).  VOICEBANK_RAMP_STEP applies updates at the block boundary, as before.
+ */
+#define VOICEBANK_RAMP_STEP 0
+#define VOICEBANK_RAMP_LINEAR 1
+#define VOICEBANK_RAMP_EXPONENTIAL 2
+void VoiceBank_setRamp(struct VoiceBank_context* ctxp,int ramp);
+
+/*
+ * Bit v is set while voice v is sounding, from its attack until its release has ramped to silence.
+ * Only these voices are rendered.
+ */
+unsigned int VoiceBank_getActive(struct VoiceBank_context* ctxp);
+
+/*
+ * Run the RawEngine kernel at 1, 2 or 4 times the sample rate, and filter the mix back down, to
+ * keep the harmonics of high, bright notes from aliasing.  Costs roughly factor times the voices
+ * plus a fixed filter per block.  Ignored while a wavetable bank is set.  A change mid-note doesn't
+ * click: the old factor plays on for 96 samples, crossfading to the new one over the last 64, and
+ * changes made meanwhile wait for it to finish.
+ */
+void VoiceBank_setOversampling(struct VoiceBank_context* ctxp,int factor);
+int VoiceBank_getOversampling(struct VoiceBank_context* ctxp);
+
+/*
+ * Render voices from a band-limited wavetable bank instead of the RawEngine kernel, or go back to
+ * the kernel with NULL.  The bank isn't owned; it must outlive its use here.
+ */
+void VoiceBank_setWavetable(struct VoiceBank_context* ctxp,struct Wavetable_bank* wavetable);
+struct Wavetable_bank* VoiceBank_getWavetable(struct VoiceBank_context* ctxp);
+
+/*
+ * Take patch parameters (corner gains, gain, tuning) from params, which the UI publishes to.
+ * The newest set is picked up at the start of each render and glided to, so parameters can be
+ * changed from another thread while this one renders.  NULL goes back to the defaults.
+ * params isn't owned.
+ */
+void VoiceBank_setParams(struct VoiceBank_context* ctxp,struct EngineParams_context* params);
+struct EngineParams_context* VoiceBank_getParams(struct VoiceBank_context* ctxp);
+
+/*
+ * The most voices that may be held at once.  When more are, the quietest are released (ramping
+ * out over the next block) and stay silent, ignoring updates, until their notes end.
+ * VoiceBank_getCulled has a bit set for each voice that is silenced this way.
+ */
+void VoiceBank_setVoiceCap(struct VoiceBank_context* ctxp,int cap);
+int VoiceBank_getVoiceCap(struct VoiceBank_context* ctxp);
+unsigned int VoiceBank_getCulled(struct VoiceBank_context* ctxp);
+
+/*
+ * Render n samples of every voice, summed into left and right.  Pass NULL for right to get a mono mix.
+ * The buffers are overwritten, not accumulated into.
+ */
+void VoiceBank_render(struct VoiceBank_context* ctxp,float* left,float* right,int n);
+
+/*
+ * Schedule more updates on one sample than the bank can queue, and fail if any note starts
+ * before that sample or is left sounding after its release.  Returns TRUE if it passed.
+ */
+int VoiceBank_selfTest(void* (*alloc)(unsigned long), void (*release)(void*),
+                       int (*fail)(const char*,...), void (*passed)());
@@ -0,0 +1,208 @@
+//
+//  Wavetable.c
+//  AlephOne
+//
+
+#include "Wavetable.h"
+#include "EngineCommon.h"
+#include <math.h>
+
+#define WAVETABLE_TWOPI 6.283185307179586
+
+struct Wavetable_bank
+{
+    float sampleRate;
+    int interpolation;
+    //Level k has sizes[k]+1 interleaved entries (the last repeats the first, so reads never wrap)
+    int sizes[WAVETABLE_LEVELS];
+    const Engine_vf* levels[WAVETABLE_LEVELS];
+    //NULL when the levels belong to someone else (a mapped file)
+    Engine_vf* tables;
+    void (*wavetableFree)(void*);
+};
+
+int Wavetable_getLevelSize(int level)
+{
+    int size = WAVETABLE_SIZE >> level;
+    return (size < WAVETABLE_MINSIZE) ? WAVETABLE_MINSIZE : size;
+}
+
+//The most harmonics that stay under Nyquist at the top of this level's octave
+static int Wavetable_levelHarmonics(int level,float sampleRate)
+{
+    double topNote = WAVETABLE_BASE_NOTE + 12*(level+1);
+    double topHz = 440 * pow(2,(topNote - 69)/12);
+    int harmonics = (int)(sampleRate / 2 / topHz);
+    int most = Wavetable_getLevelSize(level)/2 - 1;
+    if(harmonics > most)harmonics = most;
+    if(harmonics < 1)harmonics = 1;
+    return harmonics;
+}
+
+/**
+ Fourier series of RawEngine's corner waveforms, truncated at harmonics:
+   sine      sin(2pi x)
+   triangle  -8/pi^2 sum over odd h of cos(2pi h x)/h^2
+   saw       -2/pi sum of sin(2pi h x)/h
+   square    4/pi sum over odd h of sin(2pi h x)/h
+ */
+static void Wavetable_fillLevel(Engine_vf* table,int size,int harmonics)
+{
+    for(int i=0; i<=size; i++)
+    {
+        double x = (double)(i % size) / size;
+        double triangle = 0;
+        double saw = 0;
+        double square = 0;
+        for(int h=1; h<=harmonics; h++)
+        {
+            double s = sin(WAVETABLE_TWOPI*h*x) / h;
+            saw += s;
+            if(h & 1)
+            {
+                square += s;
+                triangle += cos(WAVETABLE_TWOPI*h*x) / ((double)h*h);
+            }
+        }
+        table[i][0] = (float)sin(WAVETABLE_TWOPI*x);
+        table[i][1] = (float)(-32/(WAVETABLE_TWOPI*WAVETABLE_TWOPI) * triangle);
+        table[i][2] = (float)(-4/WAVETABLE_TWOPI * saw);
+        table[i][3] = (float)(8/WAVETABLE_TWOPI * square);
+    }
+}
+
+struct Wavetable_bank* Wavetable_init(float sampleRate,
+                                      void* (*wavetableAlloc)(unsigned long),
+                                      void (*wavetableFree)(void*))
+{
+    struct Wavetable_bank* bank = wavetableAlloc(sizeof(struct Wavetable_bank));
+    bank->sampleRate = sampleRate;
+    bank->interpolation = WAVETABLE_INTERPOLATE_LINEAR;
+    bank->wavetableFree = wavetableFree;
+    int entries = 0;
+    for(int k=0; k<WAVETABLE_LEVELS; k++)
+    {
+        bank->sizes[k] = Wavetable_getLevelSize(k);
+        entries += bank->sizes[k] + 1;
+    }
+    bank->tables = wavetableAlloc(entries * sizeof(Engine_vf));
+    Engine_vf* table = bank->tables;
+    for(int k=0; k<WAVETABLE_LEVELS; k++)
+    {
+        Wavetable_fillLevel(table,bank->sizes[k],Wavetable_levelHarmonics(k,sampleRate));
+        bank->levels[k] = table;
+        table += bank->sizes[k] + 1;
+    }
+    return bank;
+}
+
+struct Wavetable_bank* Wavetable_initShared(float sampleRate,
+                                            const float* const* levels,
+                                            void* (*wavetableAlloc)(unsigned long),
+                                            void (*wavetableFree)(void*))
+{
+    struct Wavetable_bank* bank = wavetableAlloc(sizeof(struct Wavetable_bank));
+    bank->sampleRate = sampleRate;
+    bank->interpolation = WAVETABLE_INTERPOLATE_LINEAR;
+    bank->wavetableFree = wavetableFree;
+    bank->tables = NULL;
+    for(int k=0; k<WAVETABLE_LEVELS; k++)
+    {
+        bank->sizes[k] = Wavetable_getLevelSize(k);
+        bank->levels[k] = (const Engine_vf*)levels[k];
+    }
+    return bank;
+}
+
+void Wavetable_free(struct Wavetable_bank* bank)
+{
+    if(bank->tables)
+    {
+        bank->wavetableFree(bank->tables);
+    }
+    bank->wavetableFree(bank);
+}
+
+float Wavetable_getSampleRate(struct Wavetable_bank* bank)
+{
+    return bank->sampleRate;
+}
+
+const float* Wavetable_getLevel(struct Wavetable_bank* bank,int level)
+{
+    return (const float*)bank->levels[level];
+}
+
+void Wavetable_setInterpolation(struct Wavetable_bank* bank,int interpolation)
+{
+    bank->interpolation = interpolation;
+}
+
+int Wavetable_getInterpolation(struct Wavetable_bank* bank)
+{
+    return bank->interpolation;
+}
+
+/**
+ All four corners at a phase, from one level
+ */
+static inline Engine_vf Wavetable_readLinear(const Engine_vf* table,float size,float phase)
+{
+    float position = phase * size;
+    int i = (int)position;
+    float f = position - i;
+    return table[i] + (table[i+1] - table[i])*f;
+}
+
+static inline Engine_vf Wavetable_readNearest(const Engine_vf* table,float size,float phase)
+{
+    return table[(int)(phase * size + 0.5f)];
+}
+
+void Wavetable_render(struct Wavetable_bank* bank,struct Wavetable_voice* v,float* out,int n)
+{
+    //The two levels around the pitch, and how far we are from the lower one
+    float octave = (v->pitch - WAVETABLE_BASE_NOTE) / 12;
+    if(octave < 0)octave = 0;
+    if(octave > WAVETABLE_LEVELS-1)octave = WAVETABLE_LEVELS-1;
+    int k = (int)octave;
+    if(k > WAVETABLE_LEVELS-2)k = WAVETABLE_LEVELS-2;
+    float crossfade = octave - k;
+    const Engine_vf* lo = bank->levels[k];
+    const Engine_vf* hi = bank->levels[k+1];
+    float loSize = bank->sizes[k];
+    float hiSize = bank->sizes[k+1];
+
+    //The RawEngine expression mix, with the crossfade between levels folded in
+    float hiD = v->loD - 1;
+    float hiE = v->loE - 1;
+    Engine_vf weights = {v->loD*v->loE*v->cornerGain[0], hiD*v->loE*v->cornerGain[1],
+                         v->loD*hiE*v->cornerGain[2], hiD*hiE*v->cornerGain[3]};
+    Engine_vf loWeights = weights * (1 - crossfade);
+    Engine_vf hiWeights = weights * crossfade;
+
+    float phase = v->phase;
+    float increment = v->increment;
+    float level = v->level;
+    int linear = (bank->interpolation == WAVETABLE_INTERPOLATE_LINEAR);
+    for(int s=0; s<n; s++)
+    {
+        Engine_vf corners;
+        if(linear)
+        {
+            corners = Wavetable_readLinear(lo,loSize,phase)*loWeights + Wavetable_readLinear(hi,hiSize,phase)*hiWeights;
+        }
+        else
+        {
+            corners = Wavetable_readNearest(lo,loSize,phase)*loWeights + Wavetable_readNearest(hi,hiSize,phase)*hiWeights;
+        }
+        out[s] += (corners[0] + corners[1] + corners[2] + corners[3]) * level;
+        phase += increment;
+        phase -= (int)phase;
+        increment = increment*v->ratio + v->step;
+        level += v->levelStep;
+    }
+    v->phase = phase;
+    v->increment = increment;
+    v->level = level;
+}
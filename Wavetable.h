@@ -0,0 +1,88 @@
+//
+//  Wavetable.h
+//  AlephOne
+//
+// This should remain a *pure* C library with no references to external libraries
+
+/*
+ * A band-limited alternative to the RawEngine kernel's loPitch/hiPitch trick.
+ *
+ * The same four corner waveforms (sine, triangle, saw, square) are built by additive synthesis
+ * into one mip level per octave, each holding only the harmonics that stay under Nyquist at the
+ * top of its octave.  A voice reads the two levels around its pitch and crossfades between them,
+ * so it keeps its full timbre wherever that doesn't alias, instead of fading to a sine.
+ *
+ * Corners are interleaved, so one vector load fetches all four at a table position, and the
+ * expression mix is a dot product.  Levels shrink with their harmonic count (WAVETABLE_SIZE at the
+ * bottom, halving per octave down to WAVETABLE_MINSIZE), which keeps a whole bank at about 170KB:
+ * the working set of all 16 voices sits in L2 however they are spread.  Tables hold at least
+ * five samples per cycle of their top harmonic, which keeps linear interpolation error under -65dB.
+ */
+
+#define WAVETABLE_SIZE 4096
+#define WAVETABLE_MINSIZE 512
+#define WAVETABLE_LEVELS 10
+#define WAVETABLE_CORNERS 4
+//Level k covers notes WAVETABLE_BASE_NOTE+12k up to the next octave
+#define WAVETABLE_BASE_NOTE 12
+
+//How table positions between samples are read
+#define WAVETABLE_INTERPOLATE_NEAREST 0
+#define WAVETABLE_INTERPOLATE_LINEAR 1
+
+struct Wavetable_bank;
+
+/*
+ * Everything one voice needs to render a stretch with the wavetables.  The increment ramps as
+ * increment = increment*ratio + step each sample, and level by levelStep, like the voice bank.
+ * cornerGain scales each corner's waveform (1 as designed); like loD and loE it is held for the stretch.
+ */
+struct Wavetable_voice
+{
+    float phase;
+    float increment;
+    float ratio;
+    float step;
+    float level;
+    float levelStep;
+    float pitch;
+    float loD;
+    float loE;
+    float cornerGain[WAVETABLE_CORNERS];
+};
+
+/*
+ * Build the mip levels for a sample rate.  This is the expensive part (around a
+ * hundred milliseconds of additive synthesis), so do it once per patch and keep the bank, or
+ * precompute it with MakeWavetables and map it with WavetableFile.
+ */
+struct Wavetable_bank* Wavetable_init(float sampleRate,
+                                      void* (*wavetableAlloc)(unsigned long),
+                                      void (*wavetableFree)(void*));
+
+/*
+ * A bank over levels that were built elsewhere, such as a file mapped by WavetableFile.  Level k
+ * must hold Wavetable_getLevelSize(k)+1 entries of WAVETABLE_CORNERS floats, 16 byte aligned, laid
+ * out as Wavetable_getLevel returns them.  The levels aren't copied or freed, so they must outlive the bank.
+ */
+struct Wavetable_bank* Wavetable_initShared(float sampleRate,
+                                            const float* const* levels,
+                                            void* (*wavetableAlloc)(unsigned long),
+                                            void (*wavetableFree)(void*));
+
+void Wavetable_free(struct Wavetable_bank* bank);
+
+/*
+ * Entries in a level, not counting the guard entry at the end that repeats the first.
+ */
+int Wavetable_getLevelSize(int level);
+const float* Wavetable_getLevel(struct Wavetable_bank* bank,int level);
+float Wavetable_getSampleRate(struct Wavetable_bank* bank);
+
+void Wavetable_setInterpolation(struct Wavetable_bank* bank,int interpolation);
+int Wavetable_getInterpolation(struct Wavetable_bank* bank);
+
+/*
+ * Render n samples of a voice, adding them into out, and advance its phase and ramps.
+ */
+void Wavetable_render(struct Wavetable_bank* bank,struct Wavetable_voice* v,float* out,int n);
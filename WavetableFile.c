@@ -0,0 +1,218 @@
+//
+//  WavetableFile.c
+//  AlephOne
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include "WavetableFile.h"
+#include "Wavetable.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "FretlessCommon.h"
+
+#define WAVETABLEFILE_MAGIC "AOWTBANK"
+//Written as is, so a file from a machine of the other byte order reads back wrong
+#define WAVETABLEFILE_BYTEORDER 0x01020304
+#define WAVETABLEFILE_LINE 64
+#define WAVETABLEFILE_TEMP ".tmp"
+
+struct WavetableFile_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    float sampleRate;
+    uint32_t levels;
+    uint32_t corners;
+    uint32_t sizes[WAVETABLE_LEVELS];
+    uint64_t offsets[WAVETABLE_LEVELS];
+    uint64_t length;
+};
+
+struct WavetableFile
+{
+    const unsigned char* map;
+    long length;
+    struct Wavetable_bank* bank;
+};
+
+static void* WavetableFile_alloc(unsigned long size)
+{
+    return malloc(size);
+}
+
+static uint64_t WavetableFile_levelBytes(int level)
+{
+    return (uint64_t)(Wavetable_getLevelSize(level) + 1) * WAVETABLE_CORNERS * sizeof(float);
+}
+
+static uint64_t WavetableFile_roundUp(uint64_t n, uint64_t to)
+{
+    return (n + to - 1) / to * to;
+}
+
+//Where everything goes, so that writing and checking agree
+static void WavetableFile_layout(struct WavetableFile_header* header, float sampleRate)
+{
+    memset(header,0,sizeof(struct WavetableFile_header));
+    memcpy(header->magic,WAVETABLEFILE_MAGIC,sizeof(header->magic));
+    header->version = WAVETABLEFILE_VERSION;
+    header->byteOrder = WAVETABLEFILE_BYTEORDER;
+    header->sampleRate = sampleRate;
+    header->levels = WAVETABLE_LEVELS;
+    header->corners = WAVETABLE_CORNERS;
+    uint64_t offset = WAVETABLEFILE_PAGE;
+    for(int k=0; k<WAVETABLE_LEVELS; k++)
+    {
+        header->sizes[k] = Wavetable_getLevelSize(k);
+        header->offsets[k] = offset;
+        offset = WavetableFile_roundUp(offset + WavetableFile_levelBytes(k),WAVETABLEFILE_LINE);
+    }
+    header->length = WavetableFile_roundUp(offset,WAVETABLEFILE_PAGE);
+}
+
+int WavetableFile_write(const char* fname, float sampleRate, int (*logger)(const char*,...))
+{
+    struct WavetableFile_header header;
+    WavetableFile_layout(&header,sampleRate);
+    unsigned char* image = calloc(1,header.length);
+    char* temp = malloc(strlen(fname) + sizeof(WAVETABLEFILE_TEMP));
+    if(image == NULL || temp == NULL)
+    {
+        logger("WavetableFile_write: out of memory\n");
+        free(image);
+        free(temp);
+        return FALSE;
+    }
+    struct Wavetable_bank* bank = Wavetable_init(sampleRate,WavetableFile_alloc,free);
+    memcpy(image,&header,sizeof(header));
+    for(int k=0; k<WAVETABLE_LEVELS; k++)
+    {
+        memcpy(image + header.offsets[k],Wavetable_getLevel(bank,k),WavetableFile_levelBytes(k));
+    }
+    Wavetable_free(bank);
+
+    strcpy(temp,fname);
+    strcat(temp,WAVETABLEFILE_TEMP);
+    int ok = FALSE;
+    int fd = open(temp,O_WRONLY | O_CREAT | O_TRUNC,0644);
+    if(fd < 0)
+    {
+        logger("WavetableFile_write: cannot create %s\n",temp);
+    }
+    else
+    {
+        uint64_t written = 0;
+        while(written < header.length)
+        {
+            ssize_t n = write(fd,image + written,header.length - written);
+            if(n <= 0)
+            {
+                break;
+            }
+            written += n;
+        }
+        ok = (written == header.length) && (fsync(fd) == 0);
+        close(fd);
+        if(!ok)
+        {
+            logger("WavetableFile_write: cannot write %s\n",temp);
+        }
+        else if(rename(temp,fname) != 0)
+        {
+            logger("WavetableFile_write: cannot rename %s to %s\n",temp,fname);
+            ok = FALSE;
+        }
+        if(!ok)
+        {
+            unlink(temp);
+        }
+    }
+    free(image);
+    free(temp);
+    return ok;
+}
+
+struct WavetableFile* WavetableFile_open(const char* fname, int (*logger)(const char*,...))
+{
+    int fd = open(fname,O_RDONLY);
+    if(fd < 0)
+    {
+        logger("WavetableFile_open: cannot open %s\n",fname);
+        return NULL;
+    }
+    struct stat st;
+    if(fstat(fd,&st) != 0 || st.st_size < (off_t)sizeof(struct WavetableFile_header))
+    {
+        logger("WavetableFile_open: %s is too short to be a wavetable file\n",fname);
+        close(fd);
+        return NULL;
+    }
+    const unsigned char* map = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        logger("WavetableFile_open: cannot map %s\n",fname);
+        return NULL;
+    }
+    //Compare with the layout this build would write, which checks every constant at once
+    struct WavetableFile_header found;
+    struct WavetableFile_header expected;
+    memcpy(&found,map,sizeof(found));
+    WavetableFile_layout(&expected,found.sampleRate);
+    if(memcmp(found.magic,expected.magic,sizeof(found.magic)) != 0)
+    {
+        logger("WavetableFile_open: %s is not a wavetable file\n",fname);
+    }
+    else if(found.byteOrder != expected.byteOrder)
+    {
+        logger("WavetableFile_open: %s was written with the other byte order\n",fname);
+    }
+    else if(found.version != expected.version)
+    {
+        logger("WavetableFile_open: %s is version %u, this build reads version %u; rebuild it with MakeWavetables\n",
+               fname,found.version,expected.version);
+    }
+    else if(memcmp(&found,&expected,sizeof(found)) != 0)
+    {
+        logger("WavetableFile_open: %s has different table sizes from this build; rebuild it with MakeWavetables\n",fname);
+    }
+    else if((uint64_t)st.st_size < found.length)
+    {
+        logger("WavetableFile_open: %s is truncated\n",fname);
+    }
+    else
+    {
+        posix_madvise((void*)map,st.st_size,POSIX_MADV_WILLNEED);
+        const float* levels[WAVETABLE_LEVELS];
+        for(int k=0; k<WAVETABLE_LEVELS; k++)
+        {
+            levels[k] = (const float*)(map + found.offsets[k]);
+        }
+        struct WavetableFile* file = malloc(sizeof(struct WavetableFile));
+        file->map = map;
+        file->length = st.st_size;
+        file->bank = Wavetable_initShared(found.sampleRate,levels,WavetableFile_alloc,free);
+        return file;
+    }
+    munmap((void*)map,st.st_size);
+    return NULL;
+}
+
+struct Wavetable_bank* WavetableFile_getBank(struct WavetableFile* file)
+{
+    return file->bank;
+}
+
+void WavetableFile_close(struct WavetableFile* file)
+{
+    Wavetable_free(file->bank);
+    munmap((void*)file->map,file->length);
+    free(file);
+}
@@ -0,0 +1,46 @@
+//
+//  WavetableFile.h
+//  AlephOne
+//
+// Precomputed wavetable banks on disk.
+//
+// Building a Wavetable bank is too slow to do on a live patch switch, so MakeWavetables writes
+// the levels out once, at build time, and the engine maps the file read-only.  Every process
+// that opens the same file shares one copy of the tables through the page cache, and opening
+// costs a mmap and a header check instead of any synthesis.
+//
+// Like SMF, this is a host side utility and uses the OS directly.
+
+/*
+ * Layout, in native byte order:
+ *   one page of header (struct WavetableFile_header, zero padded)
+ *   each level, Wavetable_getLevelSize(k)+1 entries of WAVETABLE_CORNERS floats,
+ *   starting on a cache line at the offset the header gives
+ * Pages are taken as WAVETABLEFILE_PAGE, the largest we run on, so the tables start on a page
+ * boundary everywhere.  Any change to the layout or to the Wavetable constants must bump
+ * WAVETABLEFILE_VERSION; files from other versions are refused rather than misread.
+ */
+#define WAVETABLEFILE_VERSION 1
+#define WAVETABLEFILE_PAGE 16384
+
+struct WavetableFile;
+
+/*
+ * Build a bank for sampleRate and write it to fname.  The file is written beside fname and renamed
+ * over it, so processes that have the old one mapped keep a consistent copy.
+ * Returns FALSE (after logging why) if it can't be written.
+ */
+int WavetableFile_write(const char* fname, float sampleRate, int (*logger)(const char*,...));
+
+/*
+ * Map a file written by WavetableFile_write and check it matches this build.
+ * Returns NULL (after logging why) if it doesn't, in which case the caller can fall back to Wavetable_init.
+ */
+struct WavetableFile* WavetableFile_open(const char* fname, int (*logger)(const char*,...));
+
+/*
+ * The bank over the mapped tables, valid until the file is closed.
+ */
+struct Wavetable_bank* WavetableFile_getBank(struct WavetableFile* file);
+
+void WavetableFile_close(struct WavetableFile* file);